@@ -0,0 +1,299 @@
+#ifndef _AUTO_PERFECT_HASH_TABLE
+#define _AUTO_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "perfectHashing.h"
+#include "ptHashing.h"
+#include "cuckooHashing.h"
+#include "monotoneHashing.h"
+
+namespace NPerfectHash
+{
+    /* What BasicAutoSet optimizes when it picks an engine. */
+    enum ETarget
+    {
+        MIN_LOOKUP_TIME,
+        MIN_MEMORY,
+        MIN_BUILD_TIME
+    };
+    
+    enum EAutoEngine
+    {
+        AUTO_SCAN,     // BasicPerfectHashSet scanning a few keys, or an empty BasicScanSet
+        AUTO_DIRECT,   // BasicPerfectHashSet on dense keys, direct addressing
+        AUTO_PT_HASH,
+        AUTO_CUCKOO,
+        AUTO_MONOTONE
+    };
+    
+    /* Measures the keys given to init() and builds the engine that best fits the target within an
+       optional byte budget. Engines are ranked from their costs on 1M random 32-bit keys:
+       lookups take 80 ns with PtHash, 110 ns with cuckoo and 165 ns with the monotone set; builds take
+       0.18 s with cuckoo, 0.3 s with the monotone set and 0.7 s with PtHash; the monotone set is the
+       smallest. A few keys are always scanned and dense keys always directly addressed, both faster
+       on every count. Each engine's bytes are estimated from the number of keys and their range, with
+       the parameter that fits the budget: load factor for cuckoo, directory bucket size for the
+       monotone set. When nothing fits, the smallest estimate is built. FKS and the slower engines never
+       win on any target and are left out. No keys build an empty BasicScanSet as AUTO_SCAN: it has no
+       table to size, and every key is impossible. */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicAutoSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned int MAX_SPAN_PER_DENSE_KEY = 32U;
+        
+        class IEngine: public IBasicSet<KeyType, SizeType>
+        {
+        public:
+            virtual ~IEngine()
+            {
+            }
+            
+            virtual unsigned long long memoryUsage() const = 0;
+        };
+        
+        template<class SetType>
+        class Engine: public IEngine
+        {
+        public:
+            SetType set;
+            
+            void init(std::vector<KeyType> const &elements)
+            {
+                set.init(elements);
+            }
+            
+            void insert(KeyType element)
+            {
+                set.insert(element);
+            }
+            
+            void erase(KeyType element)
+            {
+                set.erase(element);
+            }
+            
+            bool find(KeyType element) const
+            {
+                return set.find(element);
+            }
+            
+            bool isPossible(KeyType element) const
+            {
+                return set.isPossible(element);
+            }
+            
+            SizeType size() const
+            {
+                return set.size();
+            }
+            
+            unsigned long long memoryUsage() const
+            {
+                return sizeof(Engine) - sizeof(SetType) + set.memoryUsage();
+            }
+        };
+        
+        struct Candidate
+        {
+            EAutoEngine engine;
+            double parameter; // load factor of cuckoo, bucket size of the monotone set
+            unsigned long long estimatedBytes;
+            
+            Candidate(EAutoEngine engine, double parameter, unsigned long long estimatedBytes) : engine(engine), parameter(parameter), estimatedBytes(estimatedBytes)
+            {
+            }
+            
+            bool operator<(Candidate const &other) const
+            {
+                return estimatedBytes < other.estimatedBytes;
+            }
+        };
+        
+        ETarget target;
+        unsigned long long byteBudget;
+        EDuplicatePolicy duplicatePolicy;
+        std::unique_ptr<IEngine> set;
+        EAutoEngine engine;
+        unsigned long long estimatedBytes;
+        
+        template<class SetType>
+        SetType &emplace()
+        {
+            Engine<SetType> *newEngine = new Engine<SetType>();
+            set.reset(newEngine);
+            newEngine->set.setDuplicatePolicy(duplicatePolicy);
+            return newEngine->set;
+        }
+        
+        /* Bytes of the key and presence arrays shared by the slot-table engines, plus hashBits per key. */
+        static unsigned long long slotTableBytes(unsigned long long numberOfKeys, double hashBits)
+        {
+            return numberOfKeys * (sizeof(KeyType) + (1.0 + hashBits) / CHAR_BIT);
+        }
+        
+        static unsigned long long cuckooBytes(unsigned long long numberOfKeys, double loadFactor)
+        {
+            unsigned long long bucketBytes = 4U * sizeof(KeyType) + std::max<unsigned long long>(2U, alignof(KeyType));
+            return sizeof(BasicCuckooSet<KeyType, SizeType>) + std::ceil(numberOfKeys / (4.0 * loadFactor)) * bucketBytes;
+        }
+        
+        /* Directory entries take about 6 bits, and the Fenwick tree one SizeType per 512 keys. */
+        static unsigned long long monotoneBytes(unsigned long long numberOfKeys, unsigned int bucketSize)
+        {
+            return sizeof(BasicMonotoneSet<KeyType, SizeType>) + slotTableBytes(numberOfKeys, 6.0 / bucketSize + sizeof(SizeType) * CHAR_BIT / 512.0);
+        }
+        
+        /* Candidates in order of preference for the target. */
+        std::vector<Candidate> candidates(std::vector<KeyType> const &elements) const
+        {
+            unsigned long long numberOfKeys = elements.size();
+            std::vector<Candidate> fastest;
+            if (numberOfKeys <= BasicScanSet<KeyType, SizeType>::MAX_KEYS)
+            {
+                fastest.push_back(Candidate(AUTO_SCAN, 0.0, sizeof(BasicPerfectHashSet<KeyType, SizeType, HashType>)));
+            }
+            else
+            {
+                std::pair<typename std::vector<KeyType>::const_iterator, typename std::vector<KeyType>::const_iterator> bounds =
+                    std::minmax_element(elements.begin(), elements.end());
+                unsigned long long span = keySpan(*bounds.first, *bounds.second);
+                if (span < MAX_SPAN_PER_DENSE_KEY * numberOfKeys)
+                {
+                    fastest.push_back(Candidate(AUTO_DIRECT, 0.0, sizeof(BasicPerfectHashSet<KeyType, SizeType, HashType>) + span / 4U + 16U));
+                }
+            }
+            
+            std::vector<Candidate> ptHash(1U, Candidate(AUTO_PT_HASH, 0.0, sizeof(BasicPtHashSet<KeyType, SizeType>) + slotTableBytes(numberOfKeys, 3.1)));
+            std::vector<Candidate> cuckoo;
+            for (double loadFactor: {0.9, 0.95})
+            {
+                cuckoo.push_back(Candidate(AUTO_CUCKOO, loadFactor, cuckooBytes(numberOfKeys, loadFactor)));
+            }
+            std::vector<Candidate> monotone;
+            for (unsigned int bucketSize: {8U, 16U, 32U})
+            {
+                monotone.push_back(Candidate(AUTO_MONOTONE, bucketSize, monotoneBytes(numberOfKeys, bucketSize)));
+            }
+            
+            std::vector<Candidate> ordered(fastest);
+            if (target == MIN_BUILD_TIME)
+            {
+                ordered.insert(ordered.end(), cuckoo.begin(), cuckoo.end());
+                ordered.insert(ordered.end(), monotone.begin(), monotone.end());
+                ordered.insert(ordered.end(), ptHash.begin(), ptHash.end());
+                return ordered;
+            }
+            ordered.insert(ordered.end(), ptHash.begin(), ptHash.end());
+            ordered.insert(ordered.end(), cuckoo.begin(), cuckoo.end());
+            ordered.insert(ordered.end(), monotone.begin(), monotone.end());
+            if (target == MIN_MEMORY)
+            {
+                std::stable_sort(ordered.begin(), ordered.end());
+            }
+            return ordered;
+        }
+    
+    public:
+        BasicAutoSet() : target(MIN_LOOKUP_TIME), byteBudget(0LLU), duplicatePolicy(DETECT_WHILE_HASHING), set(new Engine<BasicPerfectHashSet<KeyType, SizeType, HashType> >()),
+                         engine(AUTO_SCAN), estimatedBytes(0LLU)
+        {
+        }
+        
+        /* Applies from the next init(); a byteBudget of 0 is unbounded. */
+        inline void setTarget(ETarget newTarget, unsigned long long newByteBudget = 0LLU)
+        {
+            target = newTarget;
+            byteBudget = newByteBudget;
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Engine chosen by the last init(). */
+        inline EAutoEngine getEngine() const
+        {
+            return engine;
+        }
+        
+        /* Estimate the choice was made on; compare with memoryUsage(). */
+        inline unsigned long long getEstimatedBytes() const
+        {
+            return estimatedBytes;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            if (elements.empty())
+            {
+                engine = AUTO_SCAN;
+                estimatedBytes = sizeof(BasicScanSet<KeyType, SizeType>);
+                emplace<BasicScanSet<KeyType, SizeType> >();
+                return;
+            }
+            std::vector<Candidate> options = candidates(elements);
+            typename std::vector<Candidate>::const_iterator choice = options.begin();
+            for (; choice != options.end() && byteBudget && choice->estimatedBytes > byteBudget; ++choice);
+            if (choice == options.end())
+            {
+                choice = std::min_element(options.begin(), options.end());
+            }
+            engine = choice->engine;
+            estimatedBytes = choice->estimatedBytes;
+            
+            switch (engine)
+            {
+                case AUTO_SCAN:
+                    emplace<BasicPerfectHashSet<KeyType, SizeType, HashType> >().setScanThreshold(BasicScanSet<KeyType, SizeType>::MAX_KEYS);
+                break; case AUTO_DIRECT:
+                    emplace<BasicPerfectHashSet<KeyType, SizeType, HashType> >().setDenseThreshold(MAX_SPAN_PER_DENSE_KEY);
+                break; case AUTO_PT_HASH:
+                    emplace<BasicPtHashSet<KeyType, SizeType> >();
+                break; case AUTO_CUCKOO:
+                    emplace<BasicCuckooSet<KeyType, SizeType> >().setMaxLoadFactor(choice->parameter);
+                break; case AUTO_MONOTONE:
+                    emplace<BasicMonotoneSet<KeyType, SizeType> >().setBucketSize(choice->parameter);
+                break;
+            }
+            set->init(elements);
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicAutoSet) + set->memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            set->insert(element);
+        }
+        
+        void erase(KeyType element)
+        {
+            set->erase(element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return set->find(element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return set->isPossible(element);
+        }
+        
+        SizeType size() const
+        {
+            return set->size();
+        }
+    };
+    
+    typedef BasicAutoSet<unsigned int, unsigned int, Hash> AutoSet;
+    typedef BasicAutoSet<unsigned long long, unsigned long long, WideHash> LargeAutoSet;
+};
+
+#endif
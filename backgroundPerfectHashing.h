@@ -0,0 +1,244 @@
+#ifndef _BACKGROUND_PERFECT_HASH_TABLE
+#define _BACKGROUND_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <climits>
+#include <exception>
+#include "perfectHashing.h"
+
+namespace NPerfectHash
+{
+    /* Serves queries from a published BasicPerfectHashSet while rebuild() constructs its replacement
+       on a background thread. The finished table is published with an atomic shared_ptr store:
+       readers see either the old or the new table, never a half-built one, and a reader still
+       holding the old table keeps it alive until its query returns. Until the first table is
+       published every key is impossible. insert() and erase() are serialized with each other and
+       with publishing, so presence bits carried over into the new table are never lost; but they
+       flip bits of the published table in place, so, as with BasicPerfectHashSet, they need
+       external synchronization against all concurrent readers, whatever keys those read. The
+       rebuild thread draws hash coefficients from its own generator, seeded from the caller's. */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicBackgroundRebuildSet: public IBasicSet<KeyType, SizeType>
+    {
+        typedef BasicPerfectHashSet<KeyType, SizeType, HashType> SetType;
+        
+        static const std::size_t CARRY_OVER_CHUNK = 4096U;
+        
+        std::shared_ptr<SetType> table; // null until the first rebuild is published
+        std::mutex writerMutex; // insert, erase, carrying presence over and publishing
+        std::vector<std::pair<KeyType, bool> > writeLog; // writes made while presence is carried over
+        bool loggingWrites;
+        std::thread rebuildThread;
+        std::atomic<bool> rebuilding;
+        std::exception_ptr rebuildException;
+        ConstructionPolicy policy;
+        EDuplicatePolicy duplicatePolicy;
+        
+        std::shared_ptr<SetType> makeTable(std::vector<KeyType> const &elements) const
+        {
+            std::shared_ptr<SetType> newTable(new SetType());
+            newTable->setConstructionPolicy(policy);
+            newTable->setDuplicatePolicy(duplicatePolicy);
+            newTable->init(elements);
+            return newTable;
+        }
+        
+        /* Keys of both tables keep their presence bit; keys only in the old table are dropped. The
+           old table is read CARRY_OVER_CHUNK keys per hold of writerMutex, so a writer waits for one
+           chunk at most; writes made in between are logged and replayed when publishing. */
+        void publish(std::shared_ptr<SetType> const &newTable, std::vector<KeyType> const &elements, bool carryOverPresence)
+        {
+            std::shared_ptr<SetType> oldTable = std::atomic_load(&table);
+            if (carryOverPresence && oldTable)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(writerMutex);
+                    writeLog.clear();
+                    loggingWrites = true;
+                }
+                for (std::size_t begin = 0; begin < elements.size(); begin += CARRY_OVER_CHUNK)
+                {
+                    std::lock_guard<std::mutex> lock(writerMutex);
+                    std::size_t end = std::min(elements.size(), begin + CARRY_OVER_CHUNK);
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        if (oldTable->isPossible(elements[i]) && oldTable->find(elements[i]))
+                        {
+                            newTable->insert(elements[i]);
+                        }
+                    }
+                }
+            }
+            
+            std::lock_guard<std::mutex> lock(writerMutex);
+            for (auto const &write: writeLog)
+            {
+                if (!newTable->isPossible(write.first))
+                {
+                    continue;
+                }
+                if (write.second)
+                {
+                    newTable->insert(write.first);
+                }
+                else
+                {
+                    newTable->erase(write.first);
+                }
+            }
+            std::vector<std::pair<KeyType, bool> >().swap(writeLog);
+            loggingWrites = false;
+            std::atomic_store(&table, newTable);
+        }
+        
+        void rebuildInBackground(std::vector<KeyType> elements, bool carryOverPresence, long long seed)
+        {
+            random_t generator;
+            generator.setSeed(seed);
+            ThreadGeneratorScope scope(generator);
+            try
+            {
+                publish(makeTable(elements), elements, carryOverPresence);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                writeLog.clear();
+                loggingWrites = false;
+                rebuildException = std::current_exception();
+            }
+            rebuilding.store(false, std::memory_order_release);
+        }
+        
+        /* Called with writerMutex held. */
+        inline SetType &writableTable(KeyType element)
+        {
+            if (!table)
+            {
+                throw ImpossibleElementException(element);
+            }
+            return *table;
+        }
+    
+    public:
+        BasicBackgroundRebuildSet() : loggingWrites(false), rebuilding(false), duplicatePolicy(DETECT_WHILE_HASHING)
+        {
+        }
+        
+        ~BasicBackgroundRebuildSet()
+        {
+            if (rebuildThread.joinable())
+            {
+                rebuildThread.join();
+            }
+        }
+        
+        /* Applies to rebuilds started afterwards. */
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Starts building a table of elements on a background thread, after waiting for the
+           previous rebuild. */
+        void rebuild(std::vector<KeyType> const &elements, bool carryOverPresence = false)
+        {
+            waitForRebuild();
+            rebuilding.store(true, std::memory_order_relaxed);
+            long long seed = threadGenerator()->next(0LL, LLONG_MAX - 1LL);
+            rebuildThread = std::thread(&BasicBackgroundRebuildSet::rebuildInBackground, this, elements, carryOverPresence, seed);
+        }
+        
+        /* Joins the running rebuild and rethrows its exception; after a failure the previous table
+           stays published. */
+        void waitForRebuild()
+        {
+            if (rebuildThread.joinable())
+            {
+                rebuildThread.join();
+            }
+            if (rebuildException)
+            {
+                std::exception_ptr exception;
+                std::swap(exception, rebuildException);
+                std::rethrow_exception(exception);
+            }
+        }
+        
+        inline bool isRebuilding() const
+        {
+            return rebuilding.load(std::memory_order_acquire);
+        }
+        
+        /* The published table, null before the first one; it stays valid for as long as the caller
+           holds it. */
+        inline std::shared_ptr<SetType const> getTable() const
+        {
+            return std::atomic_load(&table);
+        }
+        
+        /* Rebuilds synchronously; readers keep using the old table until the new one is published. */
+        void init(std::vector<KeyType> const &elements)
+        {
+            rebuild(elements);
+            waitForRebuild();
+        }
+        
+        void insert(KeyType element)
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            writableTable(element).insert(element);
+            if (loggingWrites)
+            {
+                writeLog.push_back(std::make_pair(element, true));
+            }
+        }
+        
+        void erase(KeyType element)
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            writableTable(element).erase(element);
+            if (loggingWrites)
+            {
+                writeLog.push_back(std::make_pair(element, false));
+            }
+        }
+        
+        bool find(KeyType element) const
+        {
+            std::shared_ptr<SetType> current = std::atomic_load(&table);
+            if (!current)
+            {
+                throw ImpossibleElementException(element);
+            }
+            return current->find(element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            std::shared_ptr<SetType> current = std::atomic_load(&table);
+            return current && current->isPossible(element);
+        }
+        
+        SizeType size() const
+        {
+            std::shared_ptr<SetType> current = std::atomic_load(&table);
+            return (current ? current->size() : 0U);
+        }
+    };
+    
+    typedef BasicBackgroundRebuildSet<unsigned int, unsigned int, Hash> BackgroundRebuildPerfectHashSet;
+    typedef BasicBackgroundRebuildSet<unsigned long long, unsigned long long, WideHash> BackgroundRebuildLargePerfectHashSet;
+};
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef _BBHASH_PERFECT_HASH_TABLE
+#define _BBHASH_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Minimal perfect hash set by cascading bit arrays, as in BBHash (Limasset, Rizk, Chikhi, Peterlongo):
+       level i hashes its keys into gamma * (number of keys) bits, keys that hit a bit alone keep it and
+       the colliding ones move to level i + 1. The slot of a key is the rank of its bit among all levels;
+       keys left after MAX_LEVELS levels are kept sorted and follow. Every level is a pass over its keys
+       split between numberOfThreads threads with atomic bit updates, so construction scales with cores. */
+    template<class KeyType, class SizeType>
+    class BasicBbHashSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned int MAX_LEVELS = 32U;
+        
+        double gamma;
+        unsigned int numberOfThreads;
+        EDuplicatePolicy duplicatePolicy;
+        std::vector<unsigned long long> levelSeeds;
+        std::vector<unsigned long long> levelOffsets; // first bit of every level, then the total
+        RankBitVector levels;
+        std::vector<KeyType> fallbackKeys;
+        unsigned long long numberOfRankedKeys;
+        KeySlots<KeyType, SizeType> slots;
+        
+        /* Small inputs are not worth a thread. */
+        inline unsigned long long numberOfRanges(unsigned long long count) const
+        {
+            static const unsigned long long MIN_RANGE = 4096LLU;
+            return std::max(1LLU, std::min<unsigned long long>(numberOfThreads, count / MIN_RANGE));
+        }
+        
+        /* Runs action(range, begin, end) on numberOfRanges(count) contiguous ranges of [0, count),
+           the first one on the calling thread. */
+        template<class Action>
+        void parallelFor(unsigned long long count, Action action) const
+        {
+            unsigned long long ranges = numberOfRanges(count);
+            std::vector<std::thread> threads;
+            for (unsigned long long i = 1; i < ranges; ++i)
+            {
+                threads.emplace_back(action, i, count * i / ranges, count * (i + 1LLU) / ranges);
+            }
+            action(0LLU, 0LLU, count / ranges);
+            for (auto &thread: threads)
+            {
+                thread.join();
+            }
+        }
+        
+        inline SizeType slot(KeyType element) const
+        {
+            for (unsigned int level = 0; level + 1U < levelOffsets.size(); ++level)
+            {
+                unsigned long long bit = levelOffsets[level] + fastRange(mixHash(element, levelSeeds[level]), levelOffsets[level + 1U] - levelOffsets[level]);
+                if (levels.test(bit))
+                {
+                    return levels.rank(bit);
+                }
+            }
+            typename std::vector<KeyType>::const_iterator fallback = std::lower_bound(fallbackKeys.begin(), fallbackKeys.end(), element);
+            if (fallback != fallbackKeys.end() && *fallback == element)
+            {
+                return numberOfRankedKeys + (fallback - fallbackKeys.begin());
+            }
+            return slots.numberOfSlots();
+        }
+        
+        /* Bits of keys that were alone in their bit; returns the keys for the next level. */
+        std::vector<KeyType> buildLevel(std::vector<KeyType> const &keys, unsigned long long seed, unsigned long long numberOfBits, std::vector<unsigned long long> &words)
+        {
+            unsigned long long numberOfWords = numberOfBits / 64LLU;
+            std::unique_ptr<std::atomic<unsigned long long>[]> hit(new std::atomic<unsigned long long>[numberOfWords]);
+            std::unique_ptr<std::atomic<unsigned long long>[]> collision(new std::atomic<unsigned long long>[numberOfWords]);
+            for (unsigned long long i = 0; i < numberOfWords; ++i)
+            {
+                hit[i].store(0LLU, std::memory_order_relaxed);
+                collision[i].store(0LLU, std::memory_order_relaxed);
+            }
+            
+            parallelFor(keys.size(), [&](unsigned long long, unsigned long long begin, unsigned long long end)
+                                     {
+                                         for (unsigned long long i = begin; i < end; ++i)
+                                         {
+                                             unsigned long long bit = fastRange(mixHash(keys[i], seed), numberOfBits);
+                                             unsigned long long mask = 1LLU << (bit & 63LLU);
+                                             if (hit[bit >> 6LLU].fetch_or(mask, std::memory_order_relaxed) & mask)
+                                             {
+                                                 collision[bit >> 6LLU].fetch_or(mask, std::memory_order_relaxed);
+                                             }
+                                         }
+                                     }
+            );
+            
+            unsigned long long levelOffset = words.size();
+            words.resize(levelOffset + numberOfWords);
+            for (unsigned long long i = 0; i < numberOfWords; ++i)
+            {
+                words[levelOffset + i] = hit[i].load(std::memory_order_relaxed) & ~collision[i].load(std::memory_order_relaxed);
+            }
+            
+            std::vector<std::vector<KeyType> > rangeKeys(numberOfRanges(keys.size()));
+            parallelFor(keys.size(), [&](unsigned long long range, unsigned long long begin, unsigned long long end)
+                                     {
+                                         for (unsigned long long i = begin; i < end; ++i)
+                                         {
+                                             unsigned long long bit = fastRange(mixHash(keys[i], seed), numberOfBits);
+                                             if (collision[bit >> 6LLU].load(std::memory_order_relaxed) & (1LLU << (bit & 63LLU)))
+                                             {
+                                                 rangeKeys[range].push_back(keys[i]);
+                                             }
+                                         }
+                                     }
+            );
+            std::vector<KeyType> nextKeys;
+            for (auto const &keysOfRange: rangeKeys)
+            {
+                nextKeys.insert(nextKeys.end(), keysOfRange.begin(), keysOfRange.end());
+            }
+            return nextKeys;
+        }
+    
+    public:
+        BasicBbHashSet() : gamma(2.0), numberOfThreads(std::max(1U, std::thread::hardware_concurrency())), duplicatePolicy(DETECT_WHILE_HASHING),
+            numberOfRankedKeys(0LLU)
+        {
+        }
+        
+        /* Bits per key of every level; larger builds faster with fewer levels but takes more space. */
+        inline void setGamma(double newGamma)
+        {
+            gamma = std::max(newGamma, 1.0);
+        }
+        
+        inline void setNumberOfThreads(unsigned int newNumberOfThreads)
+        {
+            numberOfThreads = std::max(newNumberOfThreads, 1U);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Levels built by the last init(). */
+        inline unsigned int getNumberOfLevels() const
+        {
+            return levelSeeds.size();
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &distinct = distinctElements(elements, duplicatePolicy, uniqueElements);
+            levelSeeds.clear();
+            levelOffsets.assign(1U, 0LLU);
+            std::vector<unsigned long long> words;
+            std::vector<KeyType> keys(distinct);
+            while (!keys.empty() && levelSeeds.size() < MAX_LEVELS)
+            {
+                unsigned long long numberOfBits = std::max(64LLU, static_cast<unsigned long long>(std::ceil(gamma * keys.size() / 64.0)) * 64LLU);
+                levelSeeds.push_back(newSeed());
+                std::vector<KeyType> nextKeys = buildLevel(keys, levelSeeds.back(), numberOfBits, words);
+                keys.swap(nextKeys);
+                levelOffsets.push_back(levelOffsets.back() + numberOfBits);
+            }
+            numberOfRankedKeys = distinct.size() - keys.size();
+            levels.assign(words);
+            std::sort(keys.begin(), keys.end());
+            fallbackKeys.swap(keys);
+            
+            slots.assign(distinct.size());
+            parallelFor(distinct.size(), [&](unsigned long long, unsigned long long begin, unsigned long long end)
+                                         {
+                                             for (unsigned long long i = begin; i < end; ++i)
+                                             {
+                                                 slots.place(slot(distinct[i]), distinct[i]);
+                                             }
+                                         }
+            );
+        }
+        
+        /* Bits of hash function per key, excluding the key and presence arrays. */
+        double hashBitsPerKey() const
+        {
+            unsigned long long bytes = sizeof(BasicBbHashSet) + levels.memoryUsage() + fallbackKeys.capacity() * sizeof(KeyType)
+                + (levelSeeds.capacity() + levelOffsets.capacity()) * sizeof(unsigned long long);
+            return bytes * CHAR_BIT / std::max(1.0, 1.0 * slots.numberOfSlots());
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicBbHashSet) + levels.memoryUsage() + fallbackKeys.capacity() * sizeof(KeyType)
+                + (levelSeeds.capacity() + levelOffsets.capacity()) * sizeof(unsigned long long) + slots.memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            slots.insert(slot(element), element);
+        }
+        
+        void erase(KeyType element)
+        {
+            slots.erase(slot(element), element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return slots.find(slot(element), element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slots.isPossible(slot(element), element);
+        }
+        
+        SizeType size() const
+        {
+            return slots.size();
+        }
+    };
+    
+    typedef BasicBbHashSet<unsigned int, unsigned int> BbHashSet;
+    typedef BasicBbHashSet<unsigned long long, unsigned long long> LargeBbHashSet;
+};
+
+#endif
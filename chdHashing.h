@@ -0,0 +1,246 @@
+#ifndef _CHD_PERFECT_HASH_TABLE
+#define _CHD_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Minimal perfect hash set by compress, hash and displace (Belazzougui, Botelho, Dietzfelbinger):
+       the n keys go to n / averageBucketSize buckets, and buckets, largest first, search a
+       displacement that sends all their keys to free positions of a table of m = n / loadFactor
+       positions. Position of a key is (f1 + d0 * f2 + d1) mod m, where the displacement index encodes
+       d0 and d1 < m. The keys that land on positions >= n are remapped to the free positions < n, so
+       the keys occupy exactly n slots. Displacements are Golomb-Rice coded, the remap is a CompactArray. */
+    template<class KeyType, class SizeType>
+    class BasicChdSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned long long MIN_DISPLACEMENT_LIMIT = 1LLU << 20LLU; // searched per bucket before reseeding, at most all n * n pairs
+        
+        double averageBucketSize;
+        double loadFactor;
+        EDuplicatePolicy duplicatePolicy;
+        ConstructionPolicy policy;
+        unsigned long long seed;
+        unsigned long long numberOfBuckets;
+        unsigned long long numberOfPositions;
+        unsigned int numberOfSeeds;
+        RiceArray displacements;
+        CompactArray remap; // position - n -> free slot < n
+        KeySlots<KeyType, SizeType> slots;
+        
+        /* f1 and f2 come from the halves of the second hash. */
+        static inline unsigned long long displace(unsigned long long secondHash, unsigned long long displacement, unsigned long long numberOfPositions)
+        {
+            unsigned long long position = fastRange(secondHash, numberOfPositions) + displacement % numberOfPositions;
+            if (displacement >= numberOfPositions)
+            {
+                unsigned long long step = fastRange((secondHash << 32LLU) | (secondHash >> 32LLU), numberOfPositions);
+                position += (displacement / numberOfPositions % numberOfPositions) * step % numberOfPositions;
+            }
+            while (position >= numberOfPositions)
+            {
+                position -= numberOfPositions;
+            }
+            return position;
+        }
+        
+        inline unsigned long long positionToSlot(unsigned long long position) const
+        {
+            unsigned long long numberOfSlots = slots.numberOfSlots();
+            return (position < numberOfSlots ? position : remap[position - numberOfSlots]);
+        }
+        
+        inline SizeType slot(KeyType element) const
+        {
+            if (!numberOfPositions)
+            {
+                return 0U;
+            }
+            unsigned long long hash = mixHash(element, seed);
+            return positionToSlot(displace(mixHash(hash, seed), displacements[fastRange(hash, numberOfBuckets)], numberOfPositions));
+        }
+        
+        /* Returns false when some bucket exhausts its displacements; the caller reseeds. */
+        bool tryBuild(std::vector<KeyType> const &elements)
+        {
+            unsigned long long numberOfSlots = elements.size();
+            std::vector<unsigned long long> secondHashes(numberOfSlots);
+            std::vector<unsigned long long> bucketOffsets(numberOfBuckets + 1U, 0LLU);
+            std::vector<unsigned long long> bucketOfElement(numberOfSlots);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                unsigned long long hash = mixHash(elements[i], seed);
+                secondHashes[i] = mixHash(hash, seed);
+                bucketOfElement[i] = fastRange(hash, numberOfBuckets);
+                ++bucketOffsets[bucketOfElement[i] + 1U];
+            }
+            
+            unsigned long long largestBucket = *std::max_element(bucketOffsets.begin(), bucketOffsets.end());
+            std::vector<std::vector<unsigned long long> > bucketsOfSize(largestBucket + 1U);
+            for (unsigned long long bucket = 0; bucket < numberOfBuckets; ++bucket)
+            {
+                bucketsOfSize[bucketOffsets[bucket + 1U]].push_back(bucket);
+                bucketOffsets[bucket + 1U] += bucketOffsets[bucket];
+            }
+            std::vector<unsigned long long> bucketElements(numberOfSlots);
+            std::vector<unsigned long long> position(bucketOffsets.begin(), bucketOffsets.end() - 1);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                bucketElements[position[bucketOfElement[i]]++] = i;
+            }
+            
+            std::vector<bool> taken(numberOfPositions, false);
+            std::vector<unsigned long long> values(numberOfBuckets, 0LLU);
+            std::vector<unsigned long long> bucketSlots;
+            unsigned long long const displacementLimit = std::min(numberOfPositions * numberOfPositions, std::max(numberOfPositions, +MIN_DISPLACEMENT_LIMIT));
+            for (unsigned long long size = largestBucket; size > 0U; --size)
+            {
+                for (auto const &bucket: bucketsOfSize[size])
+                {
+                    unsigned long long displacement = 0LLU;
+                    for (; displacement < displacementLimit; ++displacement)
+                    {
+                        bucketSlots.clear();
+                        for (unsigned long long i = bucketOffsets[bucket]; i < bucketOffsets[bucket + 1U]; ++i)
+                        {
+                            unsigned long long candidate = displace(secondHashes[bucketElements[i]], displacement, numberOfPositions);
+                            if (taken[candidate])
+                            {
+                                break;
+                            }
+                            taken[candidate] = true;
+                            bucketSlots.push_back(candidate);
+                        }
+                        if (bucketSlots.size() == size)
+                        {
+                            break;
+                        }
+                        for (auto const &candidate: bucketSlots)
+                        {
+                            taken[candidate] = false;
+                        }
+                    }
+                    if (displacement == displacementLimit)
+                    {
+                        return false;
+                    }
+                    values[bucket] = displacement;
+                }
+            }
+            
+            displacements.assign(values);
+            assignRemap(taken, numberOfSlots, remap);
+            
+            slots.assign(numberOfSlots);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                slots.place(positionToSlot(displace(secondHashes[i], values[bucketOfElement[i]], numberOfPositions)), elements[i]);
+            }
+            return true;
+        }
+    
+    public:
+        BasicChdSet() : averageBucketSize(5.0), loadFactor(0.99), duplicatePolicy(DETECT_WHILE_HASHING), seed(0LLU), numberOfBuckets(1LLU), numberOfPositions(0LLU),
+            numberOfSeeds(0U)
+        {
+        }
+        
+        /* Keys per bucket; larger buckets mean fewer displacements but a longer search. */
+        inline void setAverageBucketSize(double newAverageBucketSize)
+        {
+            averageBucketSize = std::max(newAverageBucketSize, 1.0);
+        }
+        
+        /* n / m; 1 needs no remap but makes the search for the last buckets long. */
+        inline void setLoadFactor(double newLoadFactor)
+        {
+            loadFactor = std::min(std::max(newLoadFactor, 0.5), 1.0);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* maxTopLevelTrials seeds per table size; when they all fail the positions double. */
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Seeds tried by the last init(). */
+        inline unsigned int getNumberOfSeeds() const
+        {
+            return numberOfSeeds;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            numberOfBuckets = std::max(1LLU, static_cast<unsigned long long>(keys.size() / averageBucketSize));
+            numberOfPositions = std::max<unsigned long long>(keys.size(), std::ceil(keys.size() / loadFactor));
+            unsigned long long minimalNumberOfPositions = numberOfPositions;
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials = 0U;
+            numberOfSeeds = 0U;
+            do
+            {
+                if (policy.maxTopLevelTrials && numberOfTrials == policy.maxTopLevelTrials)
+                {
+                    escalateConstruction(tableFactor);
+                    numberOfPositions = minimalNumberOfPositions * tableFactor;
+                    numberOfTrials = 0U;
+                }
+                seed = newSeed();
+                ++numberOfSeeds;
+                ++numberOfTrials;
+            }
+            while (!tryBuild(keys));
+        }
+        
+        /* Bits of hash function per key, excluding the key and presence arrays. */
+        double hashBitsPerKey() const
+        {
+            return (displacements.memoryUsage() + remap.memoryUsage() + sizeof(BasicChdSet)) * CHAR_BIT / std::max(1.0, 1.0 * slots.numberOfSlots());
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicChdSet) + displacements.memoryUsage() + remap.memoryUsage() + slots.memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            slots.insert(slot(element), element);
+        }
+        
+        void erase(KeyType element)
+        {
+            slots.erase(slot(element), element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return slots.find(slot(element), element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slots.isPossible(slot(element), element);
+        }
+        
+        SizeType size() const
+        {
+            return slots.size();
+        }
+    };
+    
+    typedef BasicChdSet<unsigned int, unsigned int> ChdSet;
+    typedef BasicChdSet<unsigned long long, unsigned long long> LargeChdSet;
+};
+
+#endif
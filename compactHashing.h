@@ -0,0 +1,468 @@
+#ifndef _COMPACT_HASHING
+#define _COMPACT_HASHING
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "perfectHashing.h"
+
+namespace NPerfectHash
+{
+    /* Pieces shared by the minimal perfect hashing engines: seeded mixing, range reduction,
+       compact integer arrays and the slot table that makes their isPossible() exact. */
+    
+    /* Finalizer of MurmurHash3 on key ^ seed: every output bit depends on every input bit. */
+    inline unsigned long long mixHash(unsigned long long key, unsigned long long seed)
+    {
+        key ^= seed;
+        key ^= key >> 33LLU;
+        key *= 0xFF51AFD7ED558CCDLLU;
+        key ^= key >> 33LLU;
+        key *= 0xC4CEB9FE1A85EC53LLU;
+        key ^= key >> 33LLU;
+        return key;
+    }
+    
+    /* Keys wider than 64 bits: every 64-bit word is mixed in turn, so no bit is dropped. */
+    template<class KeyType>
+    inline typename std::enable_if<(sizeof(KeyType) > sizeof(unsigned long long)), unsigned long long>::type mixHash(KeyType key, unsigned long long seed)
+    {
+        for (unsigned int shift = sizeof(KeyType) * CHAR_BIT - 64U; shift > 0U; shift -= 64U)
+        {
+            seed = mixHash(static_cast<unsigned long long>(key >> shift), seed);
+        }
+        return mixHash(static_cast<unsigned long long>(key), seed);
+    }
+    
+    inline unsigned long long newSeed()
+    {
+        return threadGenerator()->next(0LLU, (1LLU << 62LLU));
+    }
+    
+    inline unsigned long long multiplyHigh(unsigned long long a, unsigned long long b)
+    {
+#ifdef __SIZEOF_INT128__
+        return static_cast<unsigned long long>((static_cast<unsigned __int128>(a) * b) >> 64U);
+#else
+        unsigned long long aHigh = a >> 32LLU, aLow = a & UINT_MAX;
+        unsigned long long bHigh = b >> 32LLU, bLow = b & UINT_MAX;
+        unsigned long long middle = ((aLow * bLow) >> 32LLU) + (aHigh * bLow & UINT_MAX) + (aLow * bHigh & UINT_MAX);
+        return aHigh * bHigh + (aHigh * bLow >> 32LLU) + (aLow * bHigh >> 32LLU) + (middle >> 32LLU);
+#endif
+    }
+    
+    /* Maps a uniform 64-bit hash onto [0, range) with a multiplication instead of a division. */
+    inline unsigned long long fastRange(unsigned long long hash, unsigned long long range)
+    {
+        return multiplyHigh(hash, range);
+    }
+    
+    /* width <= 64 bits at bit offset bit of a little-endian word array. */
+    inline unsigned long long readBits(std::vector<unsigned long long> const &words, unsigned long long bit, unsigned int width)
+    {
+        if (!width)
+        {
+            return 0LLU;
+        }
+        unsigned long long word = bit >> 6LLU, offset = bit & 63LLU;
+        unsigned long long value = words[word] >> offset;
+        if (offset + width > 64LLU)
+        {
+            value |= words[word + 1LLU] << (64LLU - offset);
+        }
+        return (width == 64U ? value : value & ((1LLU << width) - 1LLU));
+    }
+    
+    /* The target bits must be zero. */
+    inline void writeBits(std::vector<unsigned long long> &words, unsigned long long bit, unsigned int width, unsigned long long value)
+    {
+        if (!width)
+        {
+            return;
+        }
+        words[bit >> 6LLU] |= value << (bit & 63LLU);
+        if ((bit & 63LLU) + width > 64LLU)
+        {
+            words[(bit >> 6LLU) + 1LLU] |= value >> (64LLU - (bit & 63LLU));
+        }
+    }
+    
+    /* Position just after the rank-th (from 1) set bit at or after bit; rank 0 returns bit. */
+    inline unsigned long long skipOnes(std::vector<unsigned long long> const &words, unsigned long long bit, unsigned long long rank)
+    {
+        if (!rank)
+        {
+            return bit;
+        }
+        unsigned long long wordIndex = bit >> 6LLU;
+        unsigned long long word = words[wordIndex] & (ULLONG_MAX << (bit & 63LLU));
+        for (unsigned long long ones = __builtin_popcountll(word); ones < rank; ones = __builtin_popcountll(word))
+        {
+            rank -= ones;
+            word = words[++wordIndex];
+        }
+        for (; rank > 1U; --rank)
+        {
+            word &= word - 1LLU;
+        }
+        return (wordIndex << 6LLU) + __builtin_ctzll(word) + 1LLU;
+    }
+    
+    /* Packed array of the smallest total size: values are stored in a fixed width chosen for the
+       whole array, and the few that do not fit are escaped to a sorted exception list. Displacements
+       and pilots are mostly small with a long tail, which this encodes in a few bits each. */
+    class CompactArray
+    {
+        static const unsigned long long EXCEPTION_BITS = 128LLU;
+        std::vector<unsigned long long> words;
+        std::vector<std::pair<unsigned long long, unsigned long long> > exceptions; // index, value
+        unsigned long long numberOfValues;
+        unsigned int width;
+        unsigned long long escape;
+    
+    public:
+        CompactArray() : numberOfValues(0LLU), width(1U), escape(1LLU)
+        {
+        }
+        
+        void assign(std::vector<unsigned long long> const &values)
+        {
+            numberOfValues = values.size();
+            std::vector<unsigned long long> sortedValues(values);
+            std::sort(sortedValues.begin(), sortedValues.end());
+            unsigned long long bestBits = ULLONG_MAX;
+            for (unsigned int candidateWidth = 1U; candidateWidth <= 64U; ++candidateWidth)
+            {
+                unsigned long long candidateEscape = (candidateWidth == 64U ? ULLONG_MAX : (1LLU << candidateWidth) - 1LLU);
+                unsigned long long escaped = sortedValues.end() - std::lower_bound(sortedValues.begin(), sortedValues.end(), candidateEscape);
+                unsigned long long bits = numberOfValues * candidateWidth + escaped * EXCEPTION_BITS;
+                if (bits < bestBits)
+                {
+                    bestBits = bits;
+                    width = candidateWidth;
+                    escape = candidateEscape;
+                }
+            }
+            
+            std::vector<unsigned long long>((numberOfValues * width + 63LLU) / 64LLU, 0LLU).swap(words);
+            std::vector<std::pair<unsigned long long, unsigned long long> >().swap(exceptions);
+            for (unsigned long long i = 0; i < numberOfValues; ++i)
+            {
+                unsigned long long value = std::min(values[i], escape);
+                if (value == escape)
+                {
+                    exceptions.push_back(std::make_pair(i, values[i]));
+                }
+                writeBits(words, i * width, width, value);
+            }
+        }
+        
+        inline unsigned long long operator[](unsigned long long index) const
+        {
+            unsigned long long value = readBits(words, index * width, width);
+            if (value != escape)
+            {
+                return value;
+            }
+            return std::lower_bound(exceptions.begin(), exceptions.end(), std::make_pair(index, 0LLU))->second;
+        }
+        
+        inline unsigned long long size() const
+        {
+            return numberOfValues;
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return words.capacity() * sizeof(unsigned long long) + exceptions.capacity() * sizeof(std::pair<unsigned long long, unsigned long long>);
+        }
+    };
+    
+    /* Engines that place n keys in a table of m > n positions send the keys on positions >= n to the
+       free positions < n, in order; remap[position - n] is the slot of a taken position. */
+    inline void assignRemap(std::vector<bool> const &taken, unsigned long long numberOfSlots, CompactArray &remap)
+    {
+        std::vector<unsigned long long> remapValues(taken.size() - numberOfSlots, 0LLU);
+        unsigned long long freeSlot = 0LLU;
+        for (unsigned long long position = numberOfSlots; position < taken.size(); ++position)
+        {
+            if (taken[position])
+            {
+                for (; taken[freeSlot]; ++freeSlot);
+                remapValues[position - numberOfSlots] = freeSlot++;
+            }
+        }
+        remap.assign(remapValues);
+    }
+    
+    /* Golomb-Rice coded array: the low width bits of every value are packed, the high parts are unary
+       codes in a separate bit stream, sampled every SAMPLE_RATE values for random access. Near the
+       entropy for geometric-like values such as displacements, at the cost of a short scan per read. */
+    class RiceArray
+    {
+        static const unsigned long long SAMPLE_RATE = 64LLU;
+        std::vector<unsigned long long> lowBits;
+        std::vector<unsigned long long> unaryBits;
+        std::vector<unsigned long long> samples; // unary bit position of every SAMPLE_RATE-th value
+        unsigned long long numberOfValues;
+        unsigned int width;
+    
+    public:
+        RiceArray() : numberOfValues(0LLU), width(0U)
+        {
+        }
+        
+        void assign(std::vector<unsigned long long> const &values)
+        {
+            numberOfValues = values.size();
+            unsigned long long bestBits = ULLONG_MAX;
+            for (unsigned int candidateWidth = 0U; candidateWidth < 64U; ++candidateWidth)
+            {
+                unsigned long long bits = numberOfValues * (candidateWidth + 1LLU);
+                for (auto const &value: values)
+                {
+                    bits += value >> candidateWidth;
+                }
+                if (bits < bestBits)
+                {
+                    bestBits = bits;
+                    width = candidateWidth;
+                }
+            }
+            
+            unsigned long long unaryLength = numberOfValues;
+            for (auto const &value: values)
+            {
+                unaryLength += value >> width;
+            }
+            std::vector<unsigned long long>((numberOfValues * width + 63LLU) / 64LLU, 0LLU).swap(lowBits);
+            std::vector<unsigned long long>(unaryLength / 64LLU + 1LLU, 0LLU).swap(unaryBits);
+            std::vector<unsigned long long>().swap(samples);
+            samples.reserve((numberOfValues + SAMPLE_RATE - 1LLU) / SAMPLE_RATE);
+            unsigned long long position = 0LLU;
+            for (unsigned long long i = 0; i < numberOfValues; ++i)
+            {
+                if (i % SAMPLE_RATE == 0U)
+                {
+                    samples.push_back(position);
+                }
+                writeBits(lowBits, i * width, width, values[i] & ((1LLU << width) - 1LLU));
+                position += values[i] >> width;
+                unaryBits[position >> 6LLU] |= 1LLU << (position & 63LLU);
+                ++position;
+            }
+        }
+        
+        inline unsigned long long operator[](unsigned long long index) const
+        {
+            unsigned long long begin = skipOnes(unaryBits, samples[index / SAMPLE_RATE], index % SAMPLE_RATE);
+            unsigned long long end = skipOnes(unaryBits, begin, 1LLU) - 1LLU;
+            return ((end - begin) << width) | readBits(lowBits, index * width, width);
+        }
+        
+        inline unsigned long long size() const
+        {
+            return numberOfValues;
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return (lowBits.capacity() + unaryBits.capacity() + samples.capacity()) * sizeof(unsigned long long);
+        }
+    };
+    
+    /* Bit vector with rank: the number of ones before every block of 512 bits is stored, the rest is
+       popcounted from the block, 12.5% on top of the bits. */
+    class RankBitVector
+    {
+        static const unsigned long long WORDS_PER_BLOCK = 8LLU;
+        std::vector<unsigned long long> words;
+        std::vector<unsigned long long> blockRanks;
+    
+    public:
+        /* Takes the words over. */
+        void assign(std::vector<unsigned long long> &newWords)
+        {
+            words.swap(newWords);
+            std::vector<unsigned long long>().swap(newWords);
+            std::vector<unsigned long long>((words.size() + WORDS_PER_BLOCK - 1LLU) / WORDS_PER_BLOCK, 0LLU).swap(blockRanks);
+            unsigned long long ones = 0LLU;
+            for (unsigned long long i = 0; i < words.size(); ++i)
+            {
+                if (i % WORDS_PER_BLOCK == 0U)
+                {
+                    blockRanks[i / WORDS_PER_BLOCK] = ones;
+                }
+                ones += __builtin_popcountll(words[i]);
+            }
+        }
+        
+        inline bool test(unsigned long long bit) const
+        {
+            return (words[bit >> 6LLU] >> (bit & 63LLU)) & 1LLU;
+        }
+        
+        /* Ones before bit. */
+        inline unsigned long long rank(unsigned long long bit) const
+        {
+            unsigned long long word = bit >> 6LLU;
+            unsigned long long ones = blockRanks[word / WORDS_PER_BLOCK];
+            for (unsigned long long i = word - word % WORDS_PER_BLOCK; i < word; ++i)
+            {
+                ones += __builtin_popcountll(words[i]);
+            }
+            return ones + __builtin_popcountll(words[word] & ((1LLU << (bit & 63LLU)) - 1LLU));
+        }
+        
+        inline unsigned long long size() const
+        {
+            return words.size() * 64LLU;
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return (words.capacity() + blockRanks.capacity()) * sizeof(unsigned long long);
+        }
+    };
+    
+    /* Nondecreasing array stored as deviations from the line through its ends. Offsets of buckets that
+       hold about the same number of keys deviate by about the square root of the offset, which takes
+       half the bits of the offset itself. */
+    class MonotoneArray
+    {
+        CompactArray deviations;
+        double slope;
+        unsigned long long bias;
+        
+        inline unsigned long long expected(unsigned long long index) const
+        {
+            return static_cast<unsigned long long>(index * slope);
+        }
+    
+    public:
+        MonotoneArray() : slope(0.0), bias(0LLU)
+        {
+        }
+        
+        void assign(std::vector<unsigned long long> const &values)
+        {
+            slope = (values.size() > 1U ? 1.0 * values.back() / (values.size() - 1U) : 0.0);
+            bias = 0LLU;
+            for (unsigned long long i = 0; i < values.size(); ++i)
+            {
+                bias = std::max(bias, expected(i) - std::min(expected(i), values[i]));
+            }
+            std::vector<unsigned long long> shifted(values.size());
+            for (unsigned long long i = 0; i < values.size(); ++i)
+            {
+                shifted[i] = values[i] + bias - expected(i);
+            }
+            deviations.assign(shifted);
+        }
+        
+        inline unsigned long long operator[](unsigned long long index) const
+        {
+            return deviations[index] + expected(index) - bias;
+        }
+        
+        inline unsigned long long size() const
+        {
+            return deviations.size();
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return deviations.memoryUsage();
+        }
+    };
+    
+    /* Keys in slot order and their presence bits. A minimal perfect hash function sends every key,
+       possible or not, to some slot, so isPossible() compares the key stored there. */
+    template<class KeyType, class SizeType>
+    class KeySlots
+    {
+        std::vector<KeyType> keys;
+        std::vector<bool> presence;
+        SizeType numberOfElements;
+        
+        inline void checkPossibility(SizeType slot, KeyType element) const
+        {
+            if (!isPossible(slot, element))
+            {
+                throw ImpossibleElementException(element);
+            }
+        }
+    
+    public:
+        KeySlots() : numberOfElements(0U)
+        {
+        }
+        
+        void assign(SizeType numberOfSlots)
+        {
+            std::vector<KeyType>(numberOfSlots, KeyType(0)).swap(keys);
+            std::vector<bool>(numberOfSlots, false).swap(presence);
+            numberOfElements = 0U;
+        }
+        
+        inline void place(SizeType slot, KeyType element)
+        {
+            keys[slot] = element;
+        }
+        
+        inline bool isPossible(SizeType slot, KeyType element) const
+        {
+            return (slot < keys.size() && keys[slot] == element);
+        }
+        
+        inline void insert(SizeType slot, KeyType element)
+        {
+            checkPossibility(slot, element);
+            numberOfElements += !presence[slot];
+            presence[slot] = true;
+        }
+        
+        inline void erase(SizeType slot, KeyType element)
+        {
+            checkPossibility(slot, element);
+            numberOfElements -= presence[slot];
+            presence[slot] = false;
+        }
+        
+        inline bool find(SizeType slot, KeyType element) const
+        {
+            checkPossibility(slot, element);
+            return presence[slot];
+        }
+        
+        inline SizeType size() const
+        {
+            return numberOfElements;
+        }
+        
+        inline SizeType numberOfSlots() const
+        {
+            return keys.size();
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return keys.capacity() * sizeof(KeyType) + presence.capacity() / CHAR_BIT;
+        }
+    };
+    
+    /* Engines without their own duplicate detection build from the result; under
+       DETECT_WHILE_HASHING and THROW_ON_DUPLICATES equal elements throw EqualElementsException. */
+    template<class KeyType>
+    inline std::vector<KeyType> const &distinctElements(std::vector<KeyType> const &elements, EDuplicatePolicy duplicatePolicy, std::vector<KeyType> &uniqueElements)
+    {
+        if (findDuplicates(elements, duplicatePolicy != REMOVE_DUPLICATES, uniqueElements))
+        {
+            return uniqueElements;
+        }
+        return elements;
+    }
+};
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef _CUCKOO_HASH_TABLE
+#define _CUCKOO_HASH_TABLE
+
+#include <vector>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Bucketed cuckoo hash set: every possible key lives in one of SLOTS_PER_BUCKET slots of one of
+       its two buckets, so find() reads at most two buckets. addPossible() takes a free slot of either
+       bucket or evicts keys to their other bucket along a random walk of at most MAX_KICKS steps; the
+       table is rehashed with new seeds only when the walk fails, and doubled when the load would pass
+       maxLoadFactor, so a growing universe costs amortized O(1) per key. */
+    template<class KeyType, class SizeType>
+    class BasicCuckooSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned int SLOTS_PER_BUCKET = 4U;
+        static const unsigned int MAX_KICKS = 500U;
+        
+        struct Bucket
+        {
+            KeyType keys[SLOTS_PER_BUCKET];
+            unsigned char occupied; // one bit per slot
+            unsigned char presence;
+            
+            Bucket() : occupied(0U), presence(0U)
+            {
+            }
+        };
+        
+        double maxLoadFactor;
+        EDuplicatePolicy duplicatePolicy;
+        std::vector<Bucket> table;
+        unsigned long long firstSeed;
+        unsigned long long secondSeed;
+        unsigned long long walkState;
+        SizeType numberOfKeys;
+        SizeType numberOfElements;
+        unsigned long long numberOfRehashes;
+        
+        inline unsigned long long firstBucket(KeyType element) const
+        {
+            return fastRange(mixHash(element, firstSeed), table.size());
+        }
+        
+        inline unsigned long long secondBucket(KeyType element) const
+        {
+            return fastRange(mixHash(element, secondSeed), table.size());
+        }
+        
+        /* Slot of element as bucket * SLOTS_PER_BUCKET + index, or numberOfSlots() if it is not possible. */
+        inline unsigned long long slot(KeyType element) const
+        {
+            unsigned long long buckets[2] = {firstBucket(element), secondBucket(element)};
+            for (auto const &bucket: buckets)
+            {
+                for (unsigned int occupied = table[bucket].occupied; occupied; occupied &= occupied - 1U)
+                {
+                    unsigned int index = __builtin_ctz(occupied);
+                    if (table[bucket].keys[index] == element)
+                    {
+                        return bucket * SLOTS_PER_BUCKET + index;
+                    }
+                }
+            }
+            return numberOfSlots();
+        }
+        
+        inline unsigned long long numberOfSlots() const
+        {
+            return table.size() * SLOTS_PER_BUCKET;
+        }
+        
+        inline unsigned long long checkPossibility(KeyType element) const
+        {
+            unsigned long long currentSlot = slot(element);
+            if (currentSlot == numberOfSlots())
+            {
+                throw ImpossibleElementException(element);
+            }
+            return currentSlot;
+        }
+        
+        inline bool putIntoFreeSlot(unsigned long long bucket, KeyType element, bool present)
+        {
+            unsigned int free = ~table[bucket].occupied & ((1U << SLOTS_PER_BUCKET) - 1U);
+            if (!free)
+            {
+                return false;
+            }
+            unsigned int index = __builtin_ctz(free);
+            table[bucket].keys[index] = element;
+            table[bucket].occupied |= 1U << index;
+            table[bucket].presence = (table[bucket].presence & ~(1U << index)) | (present << index);
+            return true;
+        }
+        
+        /* Places element, evicting others; on failure the key left without a slot, which may be
+           another one, is returned through element and present. */
+        bool place(KeyType &element, bool &present)
+        {
+            unsigned long long bucket = firstBucket(element);
+            if (putIntoFreeSlot(bucket, element, present) || putIntoFreeSlot(secondBucket(element), element, present))
+            {
+                return true;
+            }
+            for (unsigned int kick = 0; kick < MAX_KICKS; ++kick)
+            {
+                unsigned int index = mixHash(++walkState, firstSeed) % SLOTS_PER_BUCKET;
+                bool evictedPresent = (table[bucket].presence >> index) & 1U;
+                std::swap(table[bucket].keys[index], element);
+                table[bucket].presence = (table[bucket].presence & ~(1U << index)) | (present << index);
+                present = evictedPresent;
+                unsigned long long first = firstBucket(element);
+                bucket = (first == bucket ? secondBucket(element) : first);
+                if (putIntoFreeSlot(bucket, element, present))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        
+        /* Places keys into at least minimalNumberOfBuckets buckets, with new seeds until they fit
+           and twice the buckets after every second failure. */
+        void rehash(std::vector<KeyType> const &keys, std::vector<bool> const &present, unsigned long long minimalNumberOfBuckets)
+        {
+            unsigned long long numberOfBuckets = std::max(minimalNumberOfBuckets,
+                static_cast<unsigned long long>(std::ceil(keys.size() / (maxLoadFactor * SLOTS_PER_BUCKET))));
+            for (unsigned int attempt = 1;; ++attempt)
+            {
+                std::vector<Bucket>(std::max(1LLU, numberOfBuckets)).swap(table);
+                firstSeed = newSeed();
+                secondSeed = newSeed();
+                SizeType placed = 0U;
+                for (; placed < keys.size(); ++placed)
+                {
+                    KeyType element = keys[placed];
+                    bool elementPresent = present[placed];
+                    if (!place(element, elementPresent))
+                    {
+                        break;
+                    }
+                }
+                if (placed == keys.size())
+                {
+                    break;
+                }
+                if (attempt % 2U == 0U)
+                {
+                    numberOfBuckets *= 2U;
+                }
+            }
+            numberOfKeys = keys.size();
+            numberOfElements = std::count(present.begin(), present.end(), true);
+            ++numberOfRehashes;
+        }
+        
+        /* Rehashes all current keys, plus homelessKey unless it is null. */
+        void rehashAll(KeyType const *homelessKey, bool homelessPresent, unsigned long long minimalNumberOfBuckets)
+        {
+            std::vector<KeyType> keys;
+            std::vector<bool> present;
+            keys.reserve(numberOfKeys + 1U);
+            present.reserve(numberOfKeys + 1U);
+            for (auto const &bucket: table)
+            {
+                for (unsigned int occupied = bucket.occupied; occupied; occupied &= occupied - 1U)
+                {
+                    keys.push_back(bucket.keys[__builtin_ctz(occupied)]);
+                    present.push_back((bucket.presence >> __builtin_ctz(occupied)) & 1U);
+                }
+            }
+            if (homelessKey)
+            {
+                keys.push_back(*homelessKey);
+                present.push_back(homelessPresent);
+            }
+            rehash(keys, present, minimalNumberOfBuckets);
+        }
+        
+        inline bool isPresent(unsigned long long currentSlot) const
+        {
+            return (table[currentSlot / SLOTS_PER_BUCKET].presence >> (currentSlot % SLOTS_PER_BUCKET)) & 1U;
+        }
+        
+        inline void setPresence(unsigned long long currentSlot, bool present)
+        {
+            unsigned char &presence = table[currentSlot / SLOTS_PER_BUCKET].presence;
+            unsigned char mask = 1U << (currentSlot % SLOTS_PER_BUCKET);
+            numberOfElements = numberOfElements + present - static_cast<bool>(presence & mask);
+            presence = (present ? presence | mask : presence & ~mask);
+        }
+    
+    public:
+        BasicCuckooSet() : maxLoadFactor(0.9), duplicatePolicy(DETECT_WHILE_HASHING), table(1U), firstSeed(0LLU), secondSeed(0LLU), walkState(0LLU),
+            numberOfKeys(0U), numberOfElements(0U), numberOfRehashes(0LLU)
+        {
+        }
+        
+        /* Keys per slot above which addPossible() doubles the table; at most 0.97, which the random walk
+           reaches with four slots per bucket. */
+        inline void setMaxLoadFactor(double newMaxLoadFactor)
+        {
+            maxLoadFactor = std::min(std::max(newMaxLoadFactor, 0.1), 0.97);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Rehashes and doublings, init() included. */
+        inline unsigned long long getNumberOfRehashes() const
+        {
+            return numberOfRehashes;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            numberOfRehashes = 0LLU;
+            rehash(keys, std::vector<bool>(keys.size(), false), 1LLU);
+        }
+        
+        /* Makes element possible and not present; does nothing if it is possible already. */
+        void addPossible(KeyType element)
+        {
+            if (slot(element) != numberOfSlots())
+            {
+                return;
+            }
+            if (numberOfKeys + 1U > maxLoadFactor * numberOfSlots())
+            {
+                rehashAll(&element, false, table.size() * 2U);
+                return;
+            }
+            bool present = false;
+            ++numberOfKeys;
+            if (!place(element, present))
+            {
+                --numberOfKeys;
+                rehashAll(&element, present, table.size());
+            }
+        }
+        
+        /* Makes element impossible; throws ImpossibleElementException if it is not possible. */
+        void removePossible(KeyType element)
+        {
+            unsigned long long currentSlot = checkPossibility(element);
+            setPresence(currentSlot, false);
+            table[currentSlot / SLOTS_PER_BUCKET].occupied &= ~(1U << (currentSlot % SLOTS_PER_BUCKET));
+            --numberOfKeys;
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicCuckooSet) + table.capacity() * sizeof(Bucket);
+        }
+        
+        /* Bits per key of everything but the keys and their presence bits: free slots and padding. */
+        double hashBitsPerKey() const
+        {
+            return (memoryUsage() - numberOfKeys * (sizeof(KeyType) + 2.0 / CHAR_BIT)) * CHAR_BIT / std::max(1.0, 1.0 * numberOfKeys);
+        }
+        
+        void insert(KeyType element)
+        {
+            setPresence(checkPossibility(element), true);
+        }
+        
+        void erase(KeyType element)
+        {
+            setPresence(checkPossibility(element), false);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return isPresent(checkPossibility(element));
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slot(element) != numberOfSlots();
+        }
+        
+        SizeType size() const
+        {
+            return numberOfElements;
+        }
+    };
+    
+    typedef BasicCuckooSet<unsigned int, unsigned int> CuckooSet;
+    typedef BasicCuckooSet<unsigned long long, unsigned long long> LargeCuckooSet;
+};
+
+#endif
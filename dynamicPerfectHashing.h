@@ -0,0 +1,371 @@
+#ifndef _DYNAMIC_PERFECT_HASH_TABLE
+#define _DYNAMIC_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <algorithm>
+#include "perfectHashing.h"
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Dynamic FKS scheme (Dietzfelbinger, Karlin, Mehlhorn, Meyer auf der Heide, Rohnert, Tarjan):
+       the set of possible keys changes through addPossible() and removePossible(). A bucket holding
+       b keys has room for capacity(b) = b + max(1, b / 2) keys in a table of capacity(b)^2 slots, so
+       a new key usually takes a free slot; a collision or a full bucket rebuilds only that bucket,
+       with a new hash function and a capacity for its new size, into a new table at the end of the
+       slot arrays. The top level is rebuilt, which also drops the abandoned tables, only when the
+       number of possible keys leaves [maxNumberOfKeys / 4, maxNumberOfKeys] or the slot arrays
+       exceed SPACE_FACTOR slots per top-level bucket; this makes updates amortized O(1). */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicDynamicPerfectHashSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned long long MIN_NUMBER_OF_KEYS = 16LLU;
+        static const unsigned long long SPACE_FACTOR = 16LLU;
+        
+        struct Bucket
+        {
+            HashType hash;
+            SizeType offset; // first slot of the table
+            SizeType sizeOfSet;
+            SizeType numberOfKeys;
+            SizeType capacity;
+            
+            Bucket() : offset(0U), sizeOfSet(0U), numberOfKeys(0U), capacity(0U)
+            {
+            }
+        };
+        
+        /* What chooseHashFunction() needs to find a hash that is injective on the keys of a bucket. */
+        struct BucketHash
+        {
+            HashType hash;
+            SizeType sizeOfSet;
+            std::vector<bool> taken;
+            
+            inline bool isBadHashFunction(std::vector<KeyType> const &elements)
+            {
+                taken.assign(sizeOfSet, false);
+                for (auto const &element: elements)
+                {
+                    SizeType currentHash = hash(element);
+                    if (taken[currentHash])
+                    {
+                        return true;
+                    }
+                    taken[currentHash] = true;
+                }
+                return false;
+            }
+        };
+        
+        std::vector<Bucket> buckets;
+        std::vector<KeyType> hashElement;
+        std::vector<bool> occupied;
+        std::vector<bool> presence;
+        BucketHash bucketHash;
+        HashType hash;
+        SizeType numberOfBuckets;
+        SizeType numberOfKeys;
+        SizeType maxNumberOfKeys;
+        SizeType numberOfElements;
+        unsigned long long numberOfGlobalRebuilds;
+        unsigned long long numberOfBucketRebuilds;
+        EDuplicatePolicy duplicatePolicy;
+        ConstructionPolicy policy;
+        
+        static inline unsigned long long capacity(unsigned long long numberOfKeys)
+        {
+            return (numberOfKeys ? numberOfKeys + std::max(1LLU, numberOfKeys / 2U) : 0LLU);
+        }
+        
+        /* Slot of element in its bucket's table, or hashElement.size() if the bucket has none. */
+        inline SizeType slot(Bucket const &bucket, KeyType element) const
+        {
+            return (bucket.sizeOfSet ? bucket.offset + bucket.hash(element) : static_cast<SizeType>(hashElement.size()));
+        }
+        
+        inline bool isPossible(SizeType currentSlot, KeyType element) const
+        {
+            return (currentSlot < hashElement.size() && occupied[currentSlot] && hashElement[currentSlot] == element);
+        }
+        
+        inline SizeType checkPossibility(KeyType element) const
+        {
+            SizeType currentSlot = slot(buckets[hash(element)], element);
+            if (!isPossible(currentSlot, element))
+            {
+                throw ImpossibleElementException(element);
+            }
+            return currentSlot;
+        }
+        
+        /* Appends the keys of the bucket and whether they are present. */
+        void collect(Bucket const &bucket, std::vector<KeyType> &keys, std::vector<bool> &present) const
+        {
+            for (SizeType i = bucket.offset; i < bucket.offset + bucket.sizeOfSet; ++i)
+            {
+                if (occupied[i])
+                {
+                    keys.push_back(hashElement[i]);
+                    present.push_back(presence[i]);
+                }
+            }
+        }
+        
+        void buildBucket(Bucket &bucket, std::vector<KeyType> const &keys, std::vector<bool> const &present)
+        {
+            bucket.numberOfKeys = keys.size();
+            bucket.capacity = capacity(keys.size());
+            bucket.sizeOfSet = 0U;
+            if (keys.empty())
+            {
+                return;
+            }
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials;
+            while (!chooseHashFunction(keys, bucketHash, tableSize<SizeType>(tableFactor, bucket.capacity, bucket.capacity), policy.maxInnerLevelTrials, numberOfTrials))
+            {
+                escalateConstruction(tableFactor);
+            }
+            bucket.hash = bucketHash.hash;
+            bucket.sizeOfSet = bucketHash.sizeOfSet;
+            bucket.offset = hashElement.size();
+            hashElement.resize(hashElement.size() + bucket.sizeOfSet, KeyType(0));
+            occupied.resize(hashElement.size(), false);
+            presence.resize(hashElement.size(), false);
+            for (SizeType i = 0; i < keys.size(); ++i)
+            {
+                SizeType currentSlot = bucket.offset + bucket.hash(keys[i]);
+                hashElement[currentSlot] = keys[i];
+                occupied[currentSlot] = true;
+                presence[currentSlot] = present[i];
+            }
+            ++numberOfBucketRebuilds;
+        }
+        
+        /* Chooses a top-level hash whose planned bucket tables fit into half of the space bound. */
+        void rebuild(std::vector<KeyType> const &keys, std::vector<bool> const &present)
+        {
+            maxNumberOfKeys = tableSize<SizeType>(2LLU, std::max<unsigned long long>(keys.size(), MIN_NUMBER_OF_KEYS / 2U), 1LLU);
+            std::vector<SizeType> offsets;
+            unsigned long long plannedSlots;
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials = 0U;
+            for (;; ++numberOfTrials)
+            {
+                if (policy.maxTopLevelTrials && numberOfTrials == policy.maxTopLevelTrials)
+                {
+                    escalateConstruction(tableFactor);
+                    numberOfTrials = 0U;
+                }
+                numberOfBuckets = tableSize<SizeType>(tableFactor, maxNumberOfKeys / 2U, 1LLU);
+                hash.setSize(numberOfBuckets);
+                hash.generateNewCoefficients();
+                offsets.assign(numberOfBuckets + 1U, 0U);
+                for (auto const &key: keys)
+                {
+                    ++offsets[hash(key)];
+                }
+                plannedSlots = 0LLU;
+                for (auto const &bucketSize: offsets)
+                {
+                    plannedSlots += capacity(bucketSize) * capacity(bucketSize);
+                }
+                if (plannedSlots <= SPACE_FACTOR / 2U * numberOfBuckets)
+                {
+                    break;
+                }
+            }
+            
+            SizeType offset = 0U;
+            for (auto &bucketOffset: offsets)
+            {
+                std::swap(offset, bucketOffset);
+                offset += bucketOffset;
+            }
+            std::vector<KeyType> partitionedKeys(keys.size());
+            std::vector<bool> partitionedPresence(keys.size());
+            std::vector<SizeType> position(offsets.begin(), offsets.end() - 1);
+            for (SizeType i = 0; i < keys.size(); ++i)
+            {
+                SizeType target = position[hash(keys[i])]++;
+                partitionedKeys[target] = keys[i];
+                partitionedPresence[target] = present[i];
+            }
+            
+            std::vector<Bucket>(numberOfBuckets).swap(buckets);
+            std::vector<KeyType>().swap(hashElement);
+            std::vector<bool>().swap(occupied);
+            std::vector<bool>().swap(presence);
+            hashElement.reserve(plannedSlots);
+            occupied.reserve(plannedSlots);
+            presence.reserve(plannedSlots);
+            numberOfKeys = keys.size();
+            numberOfElements = std::count(present.begin(), present.end(), true);
+            std::vector<KeyType> bucketKeys;
+            std::vector<bool> bucketPresence;
+            for (SizeType i = 0; i < numberOfBuckets; ++i)
+            {
+                bucketKeys.assign(partitionedKeys.begin() + offsets[i], partitionedKeys.begin() + offsets[i + 1U]);
+                bucketPresence.assign(partitionedPresence.begin() + offsets[i], partitionedPresence.begin() + offsets[i + 1U]);
+                buildBucket(buckets[i], bucketKeys, bucketPresence);
+            }
+            ++numberOfGlobalRebuilds;
+        }
+        
+        /* Rebuilds the top level from all current keys, plus addedKey unless it is null. */
+        void rebuildAll(KeyType const *addedKey)
+        {
+            std::vector<KeyType> keys;
+            std::vector<bool> present;
+            keys.reserve(numberOfKeys + 1U);
+            present.reserve(numberOfKeys + 1U);
+            for (auto const &bucket: buckets)
+            {
+                collect(bucket, keys, present);
+            }
+            if (addedKey)
+            {
+                keys.push_back(*addedKey);
+                present.push_back(false);
+            }
+            rebuild(keys, present);
+        }
+    
+    public:
+        BasicDynamicPerfectHashSet() : numberOfBuckets(0U), numberOfKeys(0U), maxNumberOfKeys(0U), numberOfElements(0U),
+            numberOfGlobalRebuilds(0LLU), numberOfBucketRebuilds(0LLU), duplicatePolicy(DETECT_WHILE_HASHING)
+        {
+            init(std::vector<KeyType>());
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Top-level rebuilds, init() included. */
+        inline unsigned long long getNumberOfGlobalRebuilds() const
+        {
+            return numberOfGlobalRebuilds;
+        }
+        
+        /* Bucket rebuilds, the ones of top-level rebuilds included. */
+        inline unsigned long long getNumberOfBucketRebuilds() const
+        {
+            return numberOfBucketRebuilds;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            numberOfGlobalRebuilds = numberOfBucketRebuilds = 0LLU;
+            rebuild(keys, std::vector<bool>(keys.size(), false));
+        }
+        
+        /* Makes element possible and not present; does nothing if it is possible already. */
+        void addPossible(KeyType element)
+        {
+            Bucket &bucket = buckets[hash(element)];
+            SizeType currentSlot = slot(bucket, element);
+            if (isPossible(currentSlot, element))
+            {
+                return;
+            }
+            if (numberOfKeys == maxNumberOfKeys)
+            {
+                rebuildAll(&element);
+                return;
+            }
+            if (bucket.numberOfKeys < bucket.capacity && !occupied[currentSlot])
+            {
+                hashElement[currentSlot] = element;
+                occupied[currentSlot] = true;
+                ++bucket.numberOfKeys;
+                ++numberOfKeys;
+                return;
+            }
+            
+            unsigned long long newCapacity = capacity(bucket.numberOfKeys + 1U);
+            if (hashElement.size() + newCapacity * newCapacity > SPACE_FACTOR * numberOfBuckets)
+            {
+                rebuildAll(&element);
+                return;
+            }
+            std::vector<KeyType> keys;
+            std::vector<bool> present;
+            collect(bucket, keys, present);
+            keys.push_back(element);
+            present.push_back(false);
+            buildBucket(bucket, keys, present);
+            ++numberOfKeys;
+        }
+        
+        /* Makes element impossible; throws ImpossibleElementException if it is not possible. */
+        void removePossible(KeyType element)
+        {
+            SizeType currentSlot = checkPossibility(element);
+            numberOfElements -= presence[currentSlot];
+            presence[currentSlot] = false;
+            occupied[currentSlot] = false;
+            --buckets[hash(element)].numberOfKeys;
+            --numberOfKeys;
+            if (maxNumberOfKeys > MIN_NUMBER_OF_KEYS && 4LLU * numberOfKeys < maxNumberOfKeys)
+            {
+                rebuildAll(NULL);
+            }
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicDynamicPerfectHashSet) + buckets.capacity() * sizeof(Bucket) + hashElement.capacity() * sizeof(KeyType)
+                + (occupied.capacity() + presence.capacity() + bucketHash.taken.capacity()) / CHAR_BIT;
+        }
+        
+        /* Bits per key of everything but the keys and their presence bits: hashes, offsets and free slots. */
+        double hashBitsPerKey() const
+        {
+            return (memoryUsage() - numberOfKeys * (sizeof(KeyType) + 2.0 / CHAR_BIT)) * CHAR_BIT / std::max(1.0, 1.0 * numberOfKeys);
+        }
+        
+        void insert(KeyType element)
+        {
+            SizeType currentSlot = checkPossibility(element);
+            numberOfElements += !presence[currentSlot];
+            presence[currentSlot] = true;
+        }
+        
+        void erase(KeyType element)
+        {
+            SizeType currentSlot = checkPossibility(element);
+            numberOfElements -= presence[currentSlot];
+            presence[currentSlot] = false;
+        }
+        
+        bool find(KeyType element) const
+        {
+            return presence[checkPossibility(element)];
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return isPossible(slot(buckets[hash(element)], element), element);
+        }
+        
+        SizeType size() const
+        {
+            return numberOfElements;
+        }
+    };
+    
+    typedef BasicDynamicPerfectHashSet<unsigned int, unsigned int, Hash> DynamicPerfectHashSet;
+    typedef BasicDynamicPerfectHashSet<unsigned long long, unsigned long long, WideHash> LargeDynamicPerfectHashSet;
+};
+
+#endif
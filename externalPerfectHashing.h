@@ -0,0 +1,352 @@
+#ifndef _EXTERNAL_PERFECT_HASH_TABLE
+#define _EXTERNAL_PERFECT_HASH_TABLE
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include "perfectHashing.h"
+
+namespace NPerfectHash
+{
+    /* Builds the BasicPerfectHashSet::save() image of a file of native KeyType keys without holding
+       the keys in memory. Every trial of a top-level hash spills the keys into numberOfPartitions runs
+       of consecutive buckets and counts the bucket sizes of one run at a time, so trials cost a write
+       and a read of the keys each; once a hash is accepted, the inner sets of one run at a time are
+       built and appended to the output. What is in memory at once is the bucket counters of one run,
+       one SizeType per top-level bucket divided by numberOfPartitions, plus the keys of the largest
+       run; the number of keys is limited to the maximum of SizeType. Temporary files get a name
+       prefix drawn per builder and are removed by build(). */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicExternalPerfectHashBuilder
+    {
+        static const unsigned int BUFFER_SIZE = 1U << 16U;
+        
+        typedef typename BasicPerfectHashSet<KeyType, SizeType, HashType>::InnerHashSet InnerHashSet;
+        
+        std::string filePrefix;
+        unsigned int numberOfPartitions;
+        ConstructionPolicy policy;
+        ConstructionStatistics statistics;
+        
+        HashType hash;
+        SizeType sizeOfSet;
+        
+        template<class ValueType>
+        static unsigned long long bytesOf(std::vector<ValueType> const &elements)
+        {
+            return elements.capacity() * sizeof(ValueType);
+        }
+        
+        static std::string newFilePrefix(std::string const &workingDirectory)
+        {
+            std::random_device device;
+            return workingDirectory + "/perfect_hash_" + std::to_string(device()) + "_" + std::to_string(device()) + "_";
+        }
+        
+        std::string partitionFileName(unsigned int partition) const
+        {
+            return filePrefix + "partition_" + std::to_string(partition) + ".bin";
+        }
+        
+        static void open(std::ifstream &in, std::string const &fileName)
+        {
+            in.open(fileName.c_str(), std::ios::binary);
+            if (!in)
+            {
+                throw StorageException("cannot open " + fileName);
+            }
+        }
+        
+        static void open(std::ofstream &out, std::string const &fileName)
+        {
+            out.open(fileName.c_str(), std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                throw StorageException("cannot create " + fileName);
+            }
+        }
+        
+        template<class Action>
+        void forEachKey(std::string const &fileName, Action action) const
+        {
+            std::ifstream in;
+            open(in, fileName);
+            std::vector<KeyType> buffer(BUFFER_SIZE);
+            while (in)
+            {
+                in.read(reinterpret_cast<char *>(buffer.data()), BUFFER_SIZE * sizeof(KeyType));
+                unsigned int numberOfKeys = in.gcount() / sizeof(KeyType);
+                for (unsigned int i = 0; i < numberOfKeys; ++i)
+                {
+                    action(buffer[i]);
+                }
+            }
+            if (!in.eof())
+            {
+                throw StorageException("cannot read " + fileName);
+            }
+        }
+        
+        unsigned int partitionOfBucket(SizeType bucket) const
+        {
+            return 1LLU * bucket * numberOfPartitions / sizeOfSet;
+        }
+        
+        SizeType firstBucketOfPartition(unsigned int partition) const
+        {
+            return (1LLU * partition * sizeOfSet + numberOfPartitions - 1U) / numberOfPartitions;
+        }
+        
+        /* Sizes of the buckets of one run, indexed from the first bucket of its partition. */
+        inline void countPartition(unsigned int partition, std::vector<SizeType> &innerSetsSizes)
+        {
+            SizeType firstBucket = firstBucketOfPartition(partition);
+            innerSetsSizes.assign(firstBucketOfPartition(partition + 1U) - firstBucket, 0U);
+            forEachKey(partitionFileName(partition), [&](KeyType key)
+                                                     {
+                                                         ++innerSetsSizes[hash(key) - firstBucket];
+                                                     }
+            );
+        }
+        
+        inline void checkInnerSetForEqualElements(unsigned int partition, SizeType bucket, SizeType innerSetSize)
+        {
+            std::vector<KeyType> setElements;
+            setElements.reserve(innerSetSize);
+            forEachKey(partitionFileName(partition), [&](KeyType key)
+                                                     {
+                                                         if (hash(key) == bucket)
+                                                         {
+                                                             setElements.push_back(key);
+                                                         }
+                                                     }
+            );
+            statistics.updatePeakConstructionBytes(bytesOf(setElements));
+            
+            std::sort(setElements.begin(), setElements.end());
+            typename std::vector<KeyType>::iterator equalElement = std::adjacent_find(setElements.begin(), setElements.end());
+            if (equalElement != setElements.end())
+            {
+                throw EqualElementsException(*equalElement);
+            }
+        }
+        
+        /* Leaves the runs of the hash on disk, ready for buildPartition() if it is accepted. */
+        inline bool isBadHashFunction(std::string const &keysFile)
+        {
+            spillPartitions(keysFile);
+            
+            unsigned long long sumOfSquaresOfInnerSetSizes = 0;
+            unsigned int largestPartition = 0U;
+            SizeType largestInnerSet = 0U;
+            SizeType largestInnerSetSize = 0U;
+            std::vector<SizeType> innerSetsSizes;
+            for (unsigned int i = 0; i < numberOfPartitions; ++i)
+            {
+                countPartition(i, innerSetsSizes);
+                statistics.updatePeakConstructionBytes(bytesOf(innerSetsSizes));
+                for (SizeType bucket = 0; bucket < innerSetsSizes.size(); ++bucket)
+                {
+                    addSquare(sumOfSquaresOfInnerSetSizes, innerSetsSizes[bucket]);
+                    if (innerSetsSizes[bucket] > largestInnerSetSize)
+                    {
+                        largestPartition = i;
+                        largestInnerSet = firstBucketOfPartition(i) + bucket;
+                        largestInnerSetSize = innerSetsSizes[bucket];
+                    }
+                }
+            }
+            
+            if (sumOfSquaresOfInnerSetSizes > 3LLU * sizeOfSet)
+            {
+                checkInnerSetForEqualElements(largestPartition, largestInnerSet, largestInnerSetSize);
+                return true;
+            }
+            return false;
+        }
+        
+        inline void chooseTopLevelHashFunction(std::string const &keysFile, unsigned long long numberOfKeys)
+        {
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials = 0U;
+            sizeOfSet = tableSize<SizeType>(tableFactor, numberOfKeys, 1LLU);
+            hash.setSize(sizeOfSet);
+            
+            do
+            {
+                if (policy.maxTopLevelTrials && numberOfTrials == policy.maxTopLevelTrials)
+                {
+                    statistics.topLevelTrials += numberOfTrials;
+                    ++statistics.topLevelFallbacks;
+                    numberOfTrials = 0U;
+                    escalateConstruction(tableFactor);
+                    sizeOfSet = tableSize<SizeType>(tableFactor, numberOfKeys, 1LLU);
+                    hash.setSize(sizeOfSet);
+                }
+                ++numberOfTrials;
+                hash.generateNewCoefficients();
+            }
+            while (isBadHashFunction(keysFile));
+            
+            statistics.topLevelTrials += numberOfTrials;
+            statistics.topLevelTableFactor = tableFactor;
+        }
+        
+        inline void spillPartitions(std::string const &keysFile)
+        {
+            std::vector<std::ofstream> partitions(numberOfPartitions);
+            for (unsigned int i = 0; i < numberOfPartitions; ++i)
+            {
+                open(partitions[i], partitionFileName(i));
+            }
+            
+            forEachKey(keysFile, [&](KeyType key)
+                                 {
+                                     writeValue(partitions[partitionOfBucket(hash(key))], key);
+                                 }
+            );
+        }
+        
+        inline void buildPartition(unsigned int partition, std::ostream &out)
+        {
+            SizeType firstBucket = firstBucketOfPartition(partition);
+            SizeType lastBucket = firstBucketOfPartition(partition + 1U);
+            
+            std::vector<SizeType> innerSetsSizes;
+            countPartition(partition, innerSetsSizes);
+            std::vector<SizeType> innerSetsOffsets(lastBucket - firstBucket + 1U, 0U);
+            for (SizeType bucket = firstBucket; bucket < lastBucket; ++bucket)
+            {
+                innerSetsOffsets[bucket - firstBucket + 1U] = innerSetsOffsets[bucket - firstBucket] + innerSetsSizes[bucket - firstBucket];
+            }
+            
+            std::vector<KeyType> partitionedElements(innerSetsOffsets.back());
+            std::vector<SizeType> position(innerSetsOffsets.begin(), innerSetsOffsets.end() - 1);
+            forEachKey(partitionFileName(partition), [&](KeyType key)
+                                                     {
+                                                         partitionedElements[position[hash(key) - firstBucket]++] = key;
+                                                     }
+            );
+            std::remove(partitionFileName(partition).c_str());
+            
+            unsigned long long partitionBytes = bytesOf(innerSetsSizes) + bytesOf(innerSetsOffsets) + bytesOf(partitionedElements) + bytesOf(position);
+            std::vector<KeyType> elements;
+            for (SizeType bucket = firstBucket; bucket < lastBucket; ++bucket)
+            {
+                elements.assign(partitionedElements.begin() + innerSetsOffsets[bucket - firstBucket], partitionedElements.begin() + innerSetsOffsets[bucket - firstBucket + 1U]);
+                InnerHashSet innerHashSet(elements, policy.maxInnerLevelTrials, statistics);
+                statistics.updatePeakConstructionBytes(partitionBytes + bytesOf(elements) + innerHashSet.memoryUsage());
+                innerHashSet.save(out);
+            }
+        }
+        
+        void removePartitions() const
+        {
+            for (unsigned int i = 0; i < numberOfPartitions; ++i)
+            {
+                std::remove(partitionFileName(i).c_str());
+            }
+        }
+    
+    public:
+        explicit BasicExternalPerfectHashBuilder(std::string const &workingDirectory, unsigned int numberOfPartitions = 64U) :
+            filePrefix(newFilePrefix(workingDirectory)), numberOfPartitions(std::max(numberOfPartitions, 1U)), sizeOfSet(0U)
+        {
+        }
+        
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Trials, fallbacks and peak bytes of the last build(). */
+        inline ConstructionStatistics const &getConstructionStatistics() const
+        {
+            return statistics;
+        }
+        
+        void build(std::string const &keysFile, std::ostream &out)
+        {
+            statistics.clear();
+            unsigned long long numberOfKeys = 0LLU;
+            forEachKey(keysFile, [&numberOfKeys](KeyType)
+                                 {
+                                     ++numberOfKeys;
+                                 }
+            );
+            if (numberOfKeys > std::numeric_limits<SizeType>::max())
+            {
+                throw StorageException("too many keys in " + keysFile);
+            }
+            
+            try
+            {
+                chooseTopLevelHashFunction(keysFile, numberOfKeys);
+                
+                writeValue(out, sizeOfSet);
+                writeValue(out, SizeType(0U)); // numberOfElements
+                hash.save(out);
+                for (unsigned int i = 0; i < numberOfPartitions; ++i)
+                {
+                    buildPartition(i, out);
+                }
+                if (!out.flush())
+                {
+                    throw StorageException("cannot write the image");
+                }
+            }
+            catch (...)
+            {
+                removePartitions();
+                throw;
+            }
+        }
+        
+        void build(std::string const &keysFile, std::string const &outputFile)
+        {
+            std::ofstream out;
+            open(out, outputFile);
+            build(keysFile, out);
+        }
+        
+        /* Streams that cannot be read twice are spooled into the working directory first. */
+        void build(std::istream &keys, std::ostream &out)
+        {
+            std::string keysFile = filePrefix + "keys.bin";
+            try
+            {
+                {
+                    std::ofstream spool;
+                    open(spool, keysFile);
+                    if (!(spool << keys.rdbuf()) && keys.peek() != std::char_traits<char>::eof())
+                    {
+                        throw StorageException("cannot spool keys into " + keysFile);
+                    }
+                }
+                build(keysFile, out);
+            }
+            catch (...)
+            {
+                std::remove(keysFile.c_str());
+                throw;
+            }
+            std::remove(keysFile.c_str());
+        }
+        
+        void build(std::istream &keys, std::string const &outputFile)
+        {
+            std::ofstream out;
+            open(out, outputFile);
+            build(keys, out);
+        }
+    };
+    
+    typedef BasicExternalPerfectHashBuilder<unsigned int, unsigned int, Hash> ExternalPerfectHashBuilder;
+    typedef BasicExternalPerfectHashBuilder<unsigned long long, unsigned long long, WideHash> LargeExternalPerfectHashBuilder;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef _FUSE_FILTER
+#define _FUSE_FILTER
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Three-way binary fuse hypergraph (Graf, Lemire) of a static key set: a key hashes to three
+       positions in consecutive segments of an array of about 1.13 positions per key for large key
+       sets. Peeling repeatedly removes a position hit by a single key together with that key; when
+       all keys are gone, assigning them in reverse order lets each key set its own position so that
+       the xor over its three positions is any value wanted for it. */
+    class FuseGraph
+    {
+    public:
+        static const unsigned int ARITY = 3U;
+    
+    private:
+        static const unsigned long long MAX_SEGMENT_LENGTH = 1LLU << 18LLU;
+        
+        unsigned long long seed;
+        unsigned long long segmentLength;
+        unsigned long long segmentCountLength; // segments where the first position may fall, times their length
+        unsigned long long numberOfPositions;
+        
+        /* Returns false if the hypergraph of the current seed does not peel. */
+        template<class KeyType>
+        bool tryPeel(std::vector<KeyType> const &keys, std::vector<std::pair<unsigned long long, unsigned char> > &order) const
+        {
+            std::vector<unsigned char> counts(numberOfPositions, 0U); // 4 * keys at the position, plus the index of the position of the last key
+            std::vector<unsigned long long> indices(numberOfPositions, 0LLU); // xor of the indices of the keys at the position
+            unsigned long long keyPositions[ARITY + 2U];
+            for (unsigned long long index = 0; index < keys.size(); ++index)
+            {
+                positions(hash(keys[index]), keyPositions);
+                for (unsigned int i = 0; i < ARITY; ++i)
+                {
+                    counts[keyPositions[i]] += 4U;
+                    counts[keyPositions[i]] ^= i;
+                    indices[keyPositions[i]] ^= index;
+                    if (counts[keyPositions[i]] < 4U)
+                    {
+                        return false;
+                    }
+                }
+            }
+            
+            std::vector<unsigned long long> alone;
+            for (unsigned long long position = 0; position < numberOfPositions; ++position)
+            {
+                if ((counts[position] >> 2U) == 1U)
+                {
+                    alone.push_back(position);
+                }
+            }
+            order.clear();
+            order.reserve(keys.size());
+            while (!alone.empty())
+            {
+                unsigned long long position = alone.back();
+                alone.pop_back();
+                if ((counts[position] >> 2U) != 1U)
+                {
+                    continue;
+                }
+                unsigned long long index = indices[position];
+                unsigned int found = counts[position] & 3U;
+                order.push_back(std::make_pair(index, static_cast<unsigned char>(found)));
+                positions(hash(keys[index]), keyPositions);
+                for (unsigned int i = 1; i < ARITY; ++i)
+                {
+                    unsigned long long other = keyPositions[found + i];
+                    counts[other] -= 4U;
+                    counts[other] ^= (found + i) % ARITY;
+                    indices[other] ^= index;
+                    if ((counts[other] >> 2U) == 1U)
+                    {
+                        alone.push_back(other);
+                    }
+                }
+            }
+            return order.size() == keys.size();
+        }
+    
+    public:
+        FuseGraph() : seed(0LLU), segmentLength(4LLU), segmentCountLength(0LLU), numberOfPositions(0LLU)
+        {
+        }
+        
+        /* Sizes the graph for numberOfKeys keys; returns the number of positions. */
+        unsigned long long setSizes(unsigned long long numberOfKeys)
+        {
+            segmentLength = (numberOfKeys ? 1LLU << static_cast<unsigned int>(std::floor(std::log(numberOfKeys) / std::log(3.33) + 2.25)) : 4LLU);
+            segmentLength = std::min(segmentLength, +MAX_SEGMENT_LENGTH);
+            double sizeFactor = (numberOfKeys > 1LLU ? std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(numberOfKeys)) : 0.0);
+            unsigned long long capacity = std::llround(numberOfKeys * sizeFactor);
+            unsigned long long segmentCount = (capacity + segmentLength - 1LLU) / segmentLength;
+            segmentCount = (segmentCount <= ARITY - 1U ? 1LLU : segmentCount - (ARITY - 1U));
+            segmentCountLength = segmentCount * segmentLength;
+            numberOfPositions = (segmentCount + ARITY - 1U) * segmentLength;
+            return numberOfPositions;
+        }
+        
+        /* Draws seeds until the distinct keys peel; order receives (index of the key, which of its
+           positions is its own) in peeling order, to be assigned from the back. */
+        template<class KeyType>
+        void peel(std::vector<KeyType> const &keys, std::vector<std::pair<unsigned long long, unsigned char> > &order)
+        {
+            do
+            {
+                seed = newSeed();
+            }
+            while (!tryPeel(keys, order));
+        }
+        
+        /* True before the first setSizes(); positions() must not be called then. */
+        inline bool empty() const
+        {
+            return !segmentCountLength;
+        }
+        
+        template<class KeyType>
+        inline unsigned long long hash(KeyType element) const
+        {
+            return mixHash(element, seed);
+        }
+        
+        /* positions[3] and positions[4] repeat positions[0] and positions[1], so that the other two
+           positions of a key are positions[found + 1] and positions[found + 2]. */
+        inline void positions(unsigned long long hash, unsigned long long (&positions)[ARITY + 2U]) const
+        {
+            positions[0] = fastRange(hash, segmentCountLength);
+            positions[1] = (positions[0] + segmentLength) ^ ((hash >> 18LLU) & (segmentLength - 1LLU));
+            positions[2] = (positions[0] + 2LLU * segmentLength) ^ (hash & (segmentLength - 1LLU));
+            positions[3] = positions[0];
+            positions[4] = positions[1];
+        }
+    };
+    
+    /* Static binary fuse filter: a key is reported when the xor of the fingerprints at its three
+       FuseGraph positions equals its own. Possible keys are always reported; other keys are with
+       probability 2^-bits of FingerprintType, at about 1.13 fingerprints per key for large key sets:
+       9 bits and 0.4% with unsigned char. */
+    template<class KeyType, class FingerprintType = unsigned char>
+    class BasicFuseFilter
+    {
+        FuseGraph graph;
+        std::vector<FingerprintType> fingerprints;
+        
+        static inline FingerprintType fingerprint(unsigned long long hash)
+        {
+            return static_cast<FingerprintType>(hash ^ (hash >> 32LLU));
+        }
+    
+    public:
+        /* Equal elements are merged; there is nothing to report them to. */
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, REMOVE_DUPLICATES, uniqueElements);
+            fingerprints.assign(graph.setSizes(keys.size()), FingerprintType(0));
+            std::vector<std::pair<unsigned long long, unsigned char> > order;
+            graph.peel(keys, order);
+            unsigned long long keyPositions[FuseGraph::ARITY + 2U];
+            for (unsigned long long i = order.size(); i-- > 0;)
+            {
+                unsigned long long hash = graph.hash(keys[order[i].first]);
+                graph.positions(hash, keyPositions);
+                unsigned int found = order[i].second;
+                fingerprints[keyPositions[found]] = fingerprint(hash) ^ fingerprints[keyPositions[found + 1U]] ^ fingerprints[keyPositions[found + 2U]];
+            }
+        }
+        
+        /* True for every key given to init(), and for other keys with probability about 2^-bits of FingerprintType. */
+        bool contains(KeyType element) const
+        {
+            if (graph.empty())
+            {
+                return false;
+            }
+            unsigned long long hash = graph.hash(element);
+            unsigned long long keyPositions[FuseGraph::ARITY + 2U];
+            graph.positions(hash, keyPositions);
+            return fingerprint(hash) == (fingerprints[keyPositions[0]] ^ fingerprints[keyPositions[1]] ^ fingerprints[keyPositions[2]]);
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicFuseFilter) + fingerprints.capacity() * sizeof(FingerprintType);
+        }
+    };
+    
+    typedef BasicFuseFilter<unsigned int> FuseFilter;
+    typedef BasicFuseFilter<unsigned long long> LargeFuseFilter;
+    
+    /* SetType whose isPossible() and find() first ask a BasicFuseFilter of the same keys: nearly all
+       impossible keys are rejected after three fingerprint loads instead of a walk of the set. */
+    template<class KeyType, class SizeType, class SetType>
+    class BasicPrefilteredSet: public IBasicSet<KeyType, SizeType>
+    {
+        SetType set;
+        BasicFuseFilter<KeyType> filter;
+    
+    public:
+        /* For configuring the set before init(). */
+        inline SetType &getSet()
+        {
+            return set;
+        }
+        
+        inline BasicFuseFilter<KeyType> const &getFilter() const
+        {
+            return filter;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            set.init(elements);
+            filter.init(elements);
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicPrefilteredSet) - sizeof(SetType) - sizeof(filter) + set.memoryUsage() + filter.memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(KeyType element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            if (!filter.contains(element))
+            {
+                throw ImpossibleElementException(element);
+            }
+            return set.find(element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return filter.contains(element) && set.isPossible(element);
+        }
+        
+        SizeType size() const
+        {
+            return set.size();
+        }
+    };
+    
+    typedef BasicPrefilteredSet<unsigned int, unsigned int, PerfectHashSet> PrefilteredPerfectHashSet;
+    typedef BasicPrefilteredSet<unsigned long long, unsigned long long, LargePerfectHashSet> PrefilteredLargePerfectHashSet;
+};
+
+#endif
@@ -0,0 +1,513 @@
+#ifndef _INCREMENTAL_PERFECT_HASH_TABLE
+#define _INCREMENTAL_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+#include "perfectHashing.h"
+
+namespace NPerfectHash
+{
+    /* Resumable init() of a BasicPerfectHashSet, so a rebuild can be spread over idle slices of an
+       event loop. Work is counted in units of roughly one hash evaluation or one element copy, and
+       step(maxWork) starts nothing new once it has done maxWork units. Two pieces of work are never
+       split, so a step can run over by one of them: the build of one inner set, retries included,
+       whose bucket has at most sqrt(3 * top-level size) elements hashed into a table of their square;
+       and, after a rejected top-level hash function, the sort of its largest bucket to look for equal
+       elements, which is every element when they are all equal. The set keeps answering queries
+       with its previous table until the step that finishes construction installs the new one. The
+       set's construction and duplicate policies are honoured. Copying the elements and the duplicate
+       pass, a radix sort, are steps too, so the constructors do no per-element work; elements given
+       by reference are read by the first steps and must stay unchanged until finished(). */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicIncrementalBuilder
+    {
+        typedef BasicPerfectHashSet<KeyType, SizeType, HashType> SetType;
+        typedef typename SetType::InnerHashSet InnerHashSet;
+        typedef typename SetType::FingerprintTable FingerprintTable;
+        
+        enum EPhase
+        {
+            COPYING,          // the caller's elements, a slice at a time
+            DIGIT_COUNTING,   // duplicate policies other than DETECT_WHILE_HASHING: LSD radix sort of elements, 8 bits per pass
+            DIGIT_SCATTERING,
+            DEDUPLICATING,    // equal neighbours of the sorted elements throw or are dropped
+            COUNTING,         // bucket sizes of the current top-level hash function
+            CHECKING,         // after a rejected hash function: collect the largest bucket to look for equal elements
+            PREFIX_SUMS,
+            PARTITIONING,
+            BUILDING,         // one inner set at a time
+            RELEASING,        // the previous inner sets of the set, popped a few at a time
+            FINISHED
+        };
+        
+        static const unsigned long long WORK_QUANTUM = 4096LLU;
+        static const unsigned int DIGIT_VALUES = 256U;
+        
+        SetType &set;
+        std::vector<KeyType> const *source; // until copied
+        std::vector<KeyType> elements;
+        EPhase phase;
+        SizeType cursor;
+        
+        unsigned int shift;
+        std::vector<SizeType> digitPositions;
+        std::vector<KeyType> sortBuffer;
+        
+        HashType hash;
+        SizeType sizeOfSet;
+        unsigned int tableFactor;
+        unsigned int numberOfTrials;
+        unsigned long long sumOfSquaresOfInnerSetSizes;
+        SizeType largestInnerSet;
+        SizeType offset;
+        std::vector<SizeType> innerSetsOffsets; // bucket sizes, then ends of buckets in partitionedElements
+        std::vector<KeyType> partitionedElements;
+        std::vector<KeyType> setElements;
+        std::vector<InnerHashSet> innerHashSets;
+        FingerprintTable fingerprintTable; // instead of innerHashSets in fingerprint mode
+        ConstructionStatistics statistics;
+        
+        /* Appends at most budget zeros towards size values; buffer must have the capacity already,
+           so that no step copies or clears a whole buffer. */
+        template<class ValueType>
+        static inline unsigned long long grow(std::vector<ValueType> &buffer, std::size_t size, unsigned long long budget)
+        {
+            std::size_t count = std::min<unsigned long long>(size - buffer.size(), budget);
+            buffer.insert(buffer.end(), count, ValueType(0));
+            return count + 1U;
+        }
+        
+        inline void startPreparation()
+        {
+            cursor = 0U;
+            shift = 0U;
+            phase = (set.duplicatePolicy == DETECT_WHILE_HASHING ? COUNTING : DIGIT_COUNTING);
+        }
+        
+        inline unsigned long long copy(unsigned long long budget)
+        {
+            SizeType end = cursor + std::min<unsigned long long>(source->size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            elements.insert(elements.end(), source->begin() + cursor, source->begin() + end);
+            cursor = end;
+            
+            if (cursor == source->size())
+            {
+                source = nullptr;
+                startPreparation();
+            }
+            return work;
+        }
+        
+        inline void nextDigit()
+        {
+            cursor = 0U;
+            shift += 8U;
+            if (shift >= sizeof(KeyType) * CHAR_BIT)
+            {
+                std::vector<KeyType>().swap(sortBuffer);
+                std::vector<SizeType>().swap(digitPositions);
+                offset = 0U;
+                phase = DEDUPLICATING;
+            }
+            else
+            {
+                phase = DIGIT_COUNTING;
+            }
+        }
+        
+        inline unsigned long long countDigits(unsigned long long budget)
+        {
+            if (!cursor)
+            {
+                digitPositions.assign(DIGIT_VALUES, 0U);
+            }
+            
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                ++digitPositions[(elements[cursor] >> shift) & 255U];
+            }
+            
+            if (cursor == elements.size())
+            {
+                work += DIGIT_VALUES;
+                if (std::count(digitPositions.begin(), digitPositions.end(), elements.size()))
+                {
+                    nextDigit(); // every element has the same digit
+                    return work;
+                }
+                SizeType digitOffset = 0U;
+                for (auto &digitPosition: digitPositions)
+                {
+                    std::swap(digitOffset, digitPosition);
+                    digitOffset += digitPosition;
+                }
+                sortBuffer.reserve(elements.size());
+                statistics.updatePeakConstructionBytes(2U * elements.capacity() * sizeof(KeyType) + DIGIT_VALUES * sizeof(SizeType));
+                phase = DIGIT_SCATTERING;
+                cursor = 0U;
+            }
+            return work;
+        }
+        
+        inline unsigned long long scatterDigits(unsigned long long budget)
+        {
+            if (sortBuffer.size() < elements.size())
+            {
+                return grow(sortBuffer, elements.size(), budget);
+            }
+            
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                sortBuffer[digitPositions[(elements[cursor] >> shift) & 255U]++] = elements[cursor];
+            }
+            
+            if (cursor == elements.size())
+            {
+                elements.swap(sortBuffer);
+                nextDigit();
+            }
+            return work;
+        }
+        
+        /* offset counts the elements kept so far, compacted to the front. */
+        inline unsigned long long deduplicate(unsigned long long budget)
+        {
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                if (offset && elements[cursor] == elements[offset - 1U])
+                {
+                    if (set.duplicatePolicy == THROW_ON_DUPLICATES)
+                    {
+                        throw EqualElementsException(elements[cursor]);
+                    }
+                    continue;
+                }
+                elements[offset++] = elements[cursor];
+            }
+            
+            if (cursor == elements.size())
+            {
+                elements.resize(offset);
+                phase = COUNTING;
+                cursor = 0U;
+            }
+            return work;
+        }
+        
+        inline void startTrial()
+        {
+            unsigned int maxTopLevelTrials = set.policy.maxTopLevelTrials;
+            if (maxTopLevelTrials && numberOfTrials == maxTopLevelTrials)
+            {
+                statistics.topLevelTrials += numberOfTrials;
+                ++statistics.topLevelFallbacks;
+                numberOfTrials = 0U;
+                escalateConstruction(tableFactor);
+            }
+            ++numberOfTrials;
+            sizeOfSet = tableSize<SizeType>(tableFactor, elements.size(), 1LLU);
+            hash.setSize(sizeOfSet);
+            hash.generateNewCoefficients();
+            innerSetsOffsets.clear();
+            innerSetsOffsets.reserve(sizeOfSet + 1U);
+            statistics.updatePeakConstructionBytes(elements.capacity() * sizeof(KeyType) + innerSetsOffsets.capacity() * sizeof(SizeType));
+            sumOfSquaresOfInnerSetSizes = 0LLU;
+            largestInnerSet = 0U;
+        }
+        
+        inline unsigned long long count(unsigned long long budget)
+        {
+            if (!cursor && innerSetsOffsets.empty())
+            {
+                startTrial();
+            }
+            if (innerSetsOffsets.size() <= sizeOfSet)
+            {
+                return grow(innerSetsOffsets, sizeOfSet + 1U, budget);
+            }
+            
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long const bound = 3LLU * sizeOfSet;
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end && sumOfSquaresOfInnerSetSizes <= bound; ++cursor)
+            {
+                SizeType bucket = hash(elements[cursor]);
+                sumOfSquaresOfInnerSetSizes += 2LLU * innerSetsOffsets[bucket]++ + 1LLU;
+                if (innerSetsOffsets[bucket] > innerSetsOffsets[largestInnerSet])
+                {
+                    largestInnerSet = bucket;
+                }
+            }
+            
+            if (sumOfSquaresOfInnerSetSizes > bound)
+            {
+                phase = CHECKING;
+                cursor = 0U;
+                setElements.clear();
+                innerSetsOffsets.clear();
+            }
+            else if (cursor == elements.size())
+            {
+                statistics.topLevelTrials += numberOfTrials;
+                statistics.topLevelTableFactor = tableFactor;
+                phase = PREFIX_SUMS;
+                cursor = 0U;
+                offset = 0U;
+            }
+            return work;
+        }
+        
+        inline unsigned long long check(unsigned long long budget)
+        {
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                if (hash(elements[cursor]) == largestInnerSet)
+                {
+                    setElements.push_back(elements[cursor]);
+                }
+            }
+            
+            if (cursor == elements.size())
+            {
+                std::sort(setElements.begin(), setElements.end());
+                typename std::vector<KeyType>::iterator equalElement = std::adjacent_find(setElements.begin(), setElements.end());
+                if (equalElement != setElements.end())
+                {
+                    throw EqualElementsException(*equalElement);
+                }
+                work += setElements.size();
+                phase = COUNTING;
+                cursor = 0U;
+            }
+            return work;
+        }
+        
+        inline unsigned long long sumPrefixes(unsigned long long budget)
+        {
+            SizeType end = cursor + std::min<unsigned long long>(innerSetsOffsets.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                std::swap(offset, innerSetsOffsets[cursor]);
+                offset += innerSetsOffsets[cursor];
+            }
+            
+            if (cursor == innerSetsOffsets.size())
+            {
+                partitionedElements.reserve(elements.size());
+                statistics.updatePeakConstructionBytes(elements.capacity() * sizeof(KeyType) * 2U + innerSetsOffsets.capacity() * sizeof(SizeType));
+                phase = PARTITIONING;
+                cursor = 0U;
+            }
+            return work;
+        }
+        
+        /* innerSetsOffsets[bucket] advances from the start to the end of its bucket. */
+        inline unsigned long long partition(unsigned long long budget)
+        {
+            if (partitionedElements.size() < elements.size())
+            {
+                return grow(partitionedElements, elements.size(), budget);
+            }
+            
+            SizeType end = cursor + std::min<unsigned long long>(elements.size() - cursor, budget);
+            unsigned long long work = end - cursor + 1U;
+            for (; cursor < end; ++cursor)
+            {
+                partitionedElements[innerSetsOffsets[hash(elements[cursor])]++] = elements[cursor];
+            }
+            
+            if (cursor == elements.size())
+            {
+                std::vector<KeyType>().swap(elements);
+                if (set.fingerprintBits)
+                {
+                    fingerprintTable.clear(set.fingerprintBits, sizeOfSet, sumOfSquaresOfInnerSetSizes);
+                }
+                else
+                {
+                    innerHashSets.reserve(sizeOfSet);
+                }
+                phase = BUILDING;
+                cursor = 0U;
+            }
+            return work;
+        }
+        
+        inline unsigned long long buildInnerHashSets(unsigned long long budget)
+        {
+            unsigned long long work = 0LLU;
+            for (; cursor < sizeOfSet && work < budget; ++cursor)
+            {
+                SizeType begin = (cursor ? innerSetsOffsets[cursor - 1U] : 0U);
+                setElements.assign(partitionedElements.begin() + begin, partitionedElements.begin() + innerSetsOffsets[cursor]);
+                if (set.fingerprintBits)
+                {
+                    fingerprintTable.append(InnerHashSet(setElements, set.policy.maxInnerLevelTrials, statistics));
+                }
+                else
+                {
+                    innerHashSets.emplace_back(setElements, set.policy.maxInnerLevelTrials, statistics);
+                }
+                work += setElements.size() + 1U;
+            }
+            
+            if (cursor == sizeOfSet)
+            {
+                install();
+            }
+            return work + 1U;
+        }
+        
+        inline void install()
+        {
+            std::vector<KeyType>().swap(partitionedElements);
+            std::vector<KeyType>().swap(setElements);
+            std::vector<SizeType>().swap(innerSetsOffsets);
+            
+            set.innerHashSets.swap(innerHashSets);
+            std::swap(set.fingerprintTable, fingerprintTable);
+            std::vector<KeyType>().swap(set.partitionedElements);
+            std::vector<SizeType>().swap(set.innerSetsOffsets);
+            set.hash = hash;
+            set.sizeOfSet = sizeOfSet;
+            set.numberOfElements = 0U;
+            set.lazyState.reset();
+            set.statistics = statistics;
+            set.engine = (set.fingerprintBits ? FINGERPRINT_ENGINE : FKS_ENGINE);
+            set.directSet = BasicDirectSet<KeyType, SizeType>();
+            phase = RELEASING;
+        }
+        
+        inline unsigned long long release(unsigned long long budget)
+        {
+            unsigned long long work = 0LLU;
+            for (; !innerHashSets.empty() && work < budget; ++work)
+            {
+                innerHashSets.pop_back();
+            }
+            
+            if (innerHashSets.empty())
+            {
+                std::vector<InnerHashSet>().swap(innerHashSets);
+                fingerprintTable = FingerprintTable();
+                phase = FINISHED;
+            }
+            return work + 1U;
+        }
+    
+    public:
+        BasicIncrementalBuilder(SetType &set, std::vector<KeyType> const &elements) :
+            set(set), source(&elements), phase(COPYING), cursor(0U), shift(0U), sizeOfSet(0U), tableFactor(1U), numberOfTrials(0U),
+            sumOfSquaresOfInnerSetSizes(0LLU), largestInnerSet(0U), offset(0U)
+        {
+            this->elements.reserve(elements.size());
+        }
+        
+        /* Takes over elements without copying them. */
+        BasicIncrementalBuilder(SetType &set, std::vector<KeyType> &&elements) :
+            set(set), source(nullptr), elements(std::move(elements)), phase(COPYING), cursor(0U), shift(0U), sizeOfSet(0U), tableFactor(1U),
+            numberOfTrials(0U), sumOfSquaresOfInnerSetSizes(0LLU), largestInnerSet(0U), offset(0U)
+        {
+            startPreparation();
+        }
+        
+        /* At most maxWork units plus the rest of one inner set build or one largest-bucket sort, see
+           above. Returns whether construction is finished. */
+        bool step(unsigned long long maxWork)
+        {
+            unsigned long long work = 0LLU;
+            while (phase != FINISHED && work < maxWork)
+            {
+                unsigned long long budget = maxWork - work;
+                switch (phase)
+                {
+                    case COPYING:
+                        work += copy(budget);
+                    break; case DIGIT_COUNTING:
+                        work += countDigits(budget);
+                    break; case DIGIT_SCATTERING:
+                        work += scatterDigits(budget);
+                    break; case DEDUPLICATING:
+                        work += deduplicate(budget);
+                    break; case COUNTING:
+                        work += count(budget);
+                    break; case CHECKING:
+                        work += check(budget);
+                    break; case PREFIX_SUMS:
+                        work += sumPrefixes(budget);
+                    break; case PARTITIONING:
+                        work += partition(budget);
+                    break; case BUILDING:
+                        work += buildInnerHashSets(budget);
+                    break; case RELEASING:
+                        work += release(budget);
+                    break; case FINISHED:
+                    break;
+                }
+            }
+            return finished();
+        }
+        
+        /* Steps in quanta of WORK_QUANTUM until construction is finished or the budget is spent. */
+        template<class Rep, class Period>
+        bool stepFor(std::chrono::duration<Rep, Period> const &budget)
+        {
+            auto deadline = std::chrono::steady_clock::now() + budget;
+            while (!step(WORK_QUANTUM) && std::chrono::steady_clock::now() < deadline);
+            return finished();
+        }
+        
+        bool finished() const
+        {
+            return phase == FINISHED;
+        }
+        
+        /* Rough fraction of the work done; a rejected top-level hash function moves it back. */
+        double progress() const
+        {
+            double numberOfElements = std::max<double>(partitionedElements.size() + elements.size(), 1.0);
+            double digits = sizeof(KeyType);
+            switch (phase)
+            {
+                case COPYING:
+                    return 0.05 * cursor / std::max<double>(source ? source->size() : 0U, 1.0);
+                case DIGIT_COUNTING:
+                case DIGIT_SCATTERING:
+                    return 0.05 + 0.1 * (shift / 8U + 0.5 * (phase == DIGIT_SCATTERING) + 0.5 * cursor / numberOfElements) / digits;
+                case DEDUPLICATING:
+                    return 0.15 + 0.05 * cursor / numberOfElements;
+                case COUNTING:
+                case CHECKING:
+                    return 0.2 + 0.1 * cursor / numberOfElements;
+                case PREFIX_SUMS:
+                    return 0.3 + 0.02 * cursor / innerSetsOffsets.size();
+                case PARTITIONING:
+                    return 0.32 + 0.18 * cursor / numberOfElements;
+                case BUILDING:
+                    return 0.5 + 0.45 * (cursor ? innerSetsOffsets[cursor - 1U] : 0U) / numberOfElements;
+                case RELEASING:
+                    return 0.95;
+                case FINISHED:
+                    break;
+            }
+            return 1.0;
+        }
+    };
+    
+    typedef BasicIncrementalBuilder<unsigned int, unsigned int, Hash> IncrementalPerfectHashBuilder;
+    typedef BasicIncrementalBuilder<unsigned long long, unsigned long long, WideHash> IncrementalLargePerfectHashBuilder;
+};
+
+#endif
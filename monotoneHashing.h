@@ -0,0 +1,257 @@
+#ifndef _MONOTONE_PERFECT_HASH_TABLE
+#define _MONOTONE_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Monotone minimal perfect hash set: the slot of a key is its rank among the possible keys, so
+       the slot table is the sorted key array and the presence bits are in key order. The rank is
+       found through a directory over the high bits of key - minimal key, with about bucketSize keys
+       per directory entry: the entry and the next one give the ranks of the keys that share its high
+       bits, and a binary search over those few keys gives the rank. A Fenwick tree over blocks
+       of presence bits counts present keys below any slot, which answers range counts. Offsets of keys
+       wider than 64 bits saturate at 2^64 - 1, which keeps the directory monotone: those keys share
+       the last entry. */
+    template<class KeyType, class SizeType>
+    class BasicMonotoneSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned long long WORDS_PER_BLOCK = 8LLU;
+        
+        unsigned int bucketSize;
+        EDuplicatePolicy duplicatePolicy;
+        KeyType minimalKey;
+        unsigned int shift;
+        unsigned long long numberOfBuckets;
+        MonotoneArray bucketRanks; // rank of the first key of every bucket, then the number of keys
+        std::vector<KeyType> keys;
+        std::vector<unsigned long long> presence;
+        std::vector<SizeType> blockCounts; // Fenwick tree of present keys per block of WORDS_PER_BLOCK words
+        SizeType numberOfElements;
+        
+        inline void checkPossibility(SizeType slot, KeyType element) const
+        {
+            if (slot == keys.size())
+            {
+                throw ImpossibleElementException(element);
+            }
+        }
+        
+        inline SizeType slot(KeyType element) const
+        {
+            SizeType rank = possibleBelow(element);
+            return (rank < keys.size() && keys[rank] == element ? rank : static_cast<SizeType>(keys.size()));
+        }
+        
+        /* delta is added modulo 2^bits of SizeType, so SizeType(0) - 1U subtracts one. */
+        void addToBlock(unsigned long long block, SizeType delta)
+        {
+            for (++block; block <= blockCounts.size(); block += block & (~block + 1LLU))
+            {
+                blockCounts[block - 1LLU] += delta;
+            }
+        }
+        
+        /* Present keys in slots below slot. */
+        SizeType presentBeforeSlot(unsigned long long slot) const
+        {
+            SizeType count = 0U;
+            unsigned long long word = slot >> 6LLU;
+            for (unsigned long long block = word / WORDS_PER_BLOCK; block > 0U; block -= block & (~block + 1LLU))
+            {
+                count += blockCounts[block - 1LLU];
+            }
+            for (unsigned long long i = word - word % WORDS_PER_BLOCK; i < word; ++i)
+            {
+                count += __builtin_popcountll(presence[i]);
+            }
+            if (slot & 63LLU)
+            {
+                count += __builtin_popcountll(presence[word] & ((1LLU << (slot & 63LLU)) - 1LLU));
+            }
+            return count;
+        }
+        
+        void setPresence(SizeType slot, bool present)
+        {
+            unsigned long long mask = 1LLU << (slot & 63LLU);
+            if (static_cast<bool>(presence[slot >> 6LLU] & mask) == present)
+            {
+                return;
+            }
+            presence[slot >> 6LLU] ^= mask;
+            SizeType delta = (present ? SizeType(1U) : SizeType(0U) - 1U);
+            addToBlock((slot >> 6LLU) / WORDS_PER_BLOCK, delta);
+            numberOfElements += delta;
+        }
+        
+        /* Calls action(key) for the present keys in slots [begin, end), in order. */
+        template<class Action>
+        void forEachPresentSlot(unsigned long long begin, unsigned long long end, Action action) const
+        {
+            for (unsigned long long word = begin >> 6LLU; (word << 6LLU) < end; ++word)
+            {
+                unsigned long long bits = presence[word];
+                if ((word << 6LLU) < begin)
+                {
+                    bits &= ULLONG_MAX << (begin & 63LLU);
+                }
+                if (((word + 1LLU) << 6LLU) > end)
+                {
+                    bits &= (1LLU << (end & 63LLU)) - 1LLU;
+                }
+                for (; bits; bits &= bits - 1LLU)
+                {
+                    action(keys[(word << 6LLU) + __builtin_ctzll(bits)]);
+                }
+            }
+        }
+    
+    public:
+        BasicMonotoneSet() : bucketSize(8U), duplicatePolicy(DETECT_WHILE_HASHING), minimalKey(0), shift(0U), numberOfBuckets(0LLU), numberOfElements(0U)
+        {
+        }
+        
+        /* Keys per directory entry on evenly spread keys; larger saves directory bits and costs
+           binary search steps. */
+        inline void setBucketSize(unsigned int newBucketSize)
+        {
+            bucketSize = std::max(newBucketSize, 1U);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> sortedKeys(distinctElements(elements, duplicatePolicy, uniqueElements));
+            std::sort(sortedKeys.begin(), sortedKeys.end());
+            keys.swap(sortedKeys);
+            std::vector<unsigned long long>((keys.size() + 63LLU) / 64LLU, 0LLU).swap(presence);
+            std::vector<SizeType>((presence.size() + WORDS_PER_BLOCK - 1LLU) / WORDS_PER_BLOCK, 0U).swap(blockCounts);
+            numberOfElements = 0U;
+            
+            minimalKey = (keys.empty() ? KeyType(0) : keys.front());
+            unsigned long long span = (keys.empty() ? 0LLU : keySpan(minimalKey, keys.back()));
+            unsigned long long targetBuckets = std::max<unsigned long long>(1LLU, keys.size() / bucketSize);
+            for (shift = 0U; shift < 63U && (span >> shift) >= targetBuckets; ++shift);
+            numberOfBuckets = (span >> shift) + 1LLU;
+            std::vector<unsigned long long> ranks(numberOfBuckets + 1U, 0LLU);
+            for (auto const &key: keys)
+            {
+                ++ranks[(keySpan(minimalKey, key) >> shift) + 1U];
+            }
+            for (unsigned long long bucket = 0; bucket < numberOfBuckets; ++bucket)
+            {
+                ranks[bucket + 1U] += ranks[bucket];
+            }
+            bucketRanks.assign(ranks);
+        }
+        
+        /* Number of possible keys below bound; defined for every bound. */
+        SizeType possibleBelow(KeyType bound) const
+        {
+            if (keys.empty() || bound <= minimalKey)
+            {
+                return 0U;
+            }
+            unsigned long long bucket = keySpan(minimalKey, bound) >> shift;
+            if (bucket >= numberOfBuckets)
+            {
+                return keys.size();
+            }
+            typename std::vector<KeyType>::const_iterator first = keys.begin() + bucketRanks[bucket];
+            return std::lower_bound(first, keys.begin() + bucketRanks[bucket + 1U], bound) - keys.begin();
+        }
+        
+        /* Position of a possible key in the sorted possible keys. */
+        SizeType rank(KeyType element) const
+        {
+            SizeType currentSlot = slot(element);
+            checkPossibility(currentSlot, element);
+            return currentSlot;
+        }
+        
+        /* Number of present keys below bound. */
+        SizeType presentBelow(KeyType bound) const
+        {
+            return presentBeforeSlot(possibleBelow(bound));
+        }
+        
+        /* Number of present keys in [low, high). */
+        SizeType countPresent(KeyType low, KeyType high) const
+        {
+            return (low < high ? presentBelow(high) - presentBelow(low) : 0U);
+        }
+        
+        /* Calls action(key) for the present keys in [low, high), in increasing order. */
+        template<class Action>
+        void forEachPresent(KeyType low, KeyType high, Action action) const
+        {
+            if (low < high)
+            {
+                forEachPresentSlot(possibleBelow(low), possibleBelow(high), action);
+            }
+        }
+        
+        /* Calls action(key) for all present keys, in increasing order. */
+        template<class Action>
+        void forEachPresent(Action action) const
+        {
+            forEachPresentSlot(0LLU, keys.size(), action);
+        }
+        
+        /* Bits of the rank directory per key, excluding the key and presence arrays. */
+        double hashBitsPerKey() const
+        {
+            return (bucketRanks.memoryUsage() + sizeof(BasicMonotoneSet)) * CHAR_BIT / std::max(1.0, 1.0 * keys.size());
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicMonotoneSet) + bucketRanks.memoryUsage() + keys.capacity() * sizeof(KeyType)
+                + presence.capacity() * sizeof(unsigned long long) + blockCounts.capacity() * sizeof(SizeType);
+        }
+        
+        void insert(KeyType element)
+        {
+            SizeType currentSlot = slot(element);
+            checkPossibility(currentSlot, element);
+            setPresence(currentSlot, true);
+        }
+        
+        void erase(KeyType element)
+        {
+            SizeType currentSlot = slot(element);
+            checkPossibility(currentSlot, element);
+            setPresence(currentSlot, false);
+        }
+        
+        bool find(KeyType element) const
+        {
+            SizeType currentSlot = slot(element);
+            checkPossibility(currentSlot, element);
+            return (presence[currentSlot >> 6LLU] >> (currentSlot & 63LLU)) & 1LLU;
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slot(element) < keys.size();
+        }
+        
+        SizeType size() const
+        {
+            return numberOfElements;
+        }
+    };
+    
+    typedef BasicMonotoneSet<unsigned int, unsigned int> MonotoneSet;
+    typedef BasicMonotoneSet<unsigned long long, unsigned long long> LargeMonotoneSet;
+};
+
+#endif
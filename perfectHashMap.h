@@ -0,0 +1,288 @@
+#ifndef _PERFECT_HASH_MAP
+#define _PERFECT_HASH_MAP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "perfectHashing.h"
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* FKS two-level map: the top-level hash picks a bucket, the bucket's hash picks a slot of its
+       quadratic table, as in BasicPerfectHashSet. Bucket hashes and table offsets sit in one flat
+       array and all slots in another, each slot holding its key, value and presence together, so
+       get(), set() and erase() compute two hashes and read one bucket and one slot. Without the
+       per-bucket inner set headers of BasicPerfectHashSet, it takes about 73% of its memory even with
+       64-bit values: 80 against 109 bytes per key on 1M random 32-bit keys. */
+    template<class KeyType, class SizeType, class ValueType, class HashType>
+    class BasicPerfectHashMap: public IBasicSet<KeyType, SizeType>
+    {
+        struct Bucket
+        {
+            HashType hash;
+            SizeType offset;
+            SizeType sizeOfSet;
+        };
+        
+        struct Slot
+        {
+            KeyType key;
+            ValueType value;
+            bool present;
+            
+            Slot() : key(0), value(), present(false)
+            {
+            }
+        };
+        
+        /* Chooses the hash of one bucket: its keys must fall on distinct slots. */
+        struct InnerHashFunction
+        {
+            HashType hash;
+            SizeType sizeOfSet;
+            std::vector<bool> taken;
+            
+            template<class Iterator>
+            bool isBadHashFunction(std::pair<Iterator, Iterator> const &elements)
+            {
+                taken.assign(sizeOfSet, false);
+                for (Iterator element = elements.first; element != elements.second; ++element)
+                {
+                    SizeType slot = hash(*element);
+                    if (taken[slot])
+                    {
+                        return true;
+                    }
+                    taken[slot] = true;
+                }
+                return false;
+            }
+        };
+        
+        std::vector<Bucket> buckets;
+        std::vector<Slot> slots;
+        HashType hash;
+        SizeType sizeOfSet;
+        SizeType numberOfElements;
+        EDuplicatePolicy duplicatePolicy;
+        ConstructionPolicy policy;
+        std::vector<SizeType> bucketOffsets; // construction only: bucket sizes, then prefix sums
+        
+        template<class SetType, class ElementsType, class TableSizeType>
+        friend bool chooseHashFunction(ElementsType const &, SetType &, TableSizeType, unsigned int, unsigned int &);
+        
+        inline bool isBadHashFunction(std::vector<KeyType> const &elements)
+        {
+            bucketOffsets.assign(sizeOfSet + 1U, 0U);
+            for (auto const &element: elements)
+            {
+                ++bucketOffsets[hash(element)];
+            }
+            unsigned long long sumOfSquaresOfBucketSizes = 0LLU;
+            for (auto const &bucketSize: bucketOffsets)
+            {
+                addSquare(sumOfSquaresOfBucketSizes, bucketSize);
+            }
+            return sumOfSquaresOfBucketSizes > 3LLU * sizeOfSet;
+        }
+        
+        inline void chooseTopLevelHashFunction(std::vector<KeyType> const &elements)
+        {
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials;
+            while (!chooseHashFunction(elements, *this, tableSize<SizeType>(tableFactor, elements.size(), 1LLU), policy.maxTopLevelTrials, numberOfTrials))
+            {
+                escalateConstruction(tableFactor);
+            }
+        }
+        
+        template<class Iterator>
+        inline void buildBucket(Bucket &bucket, Iterator begin, Iterator end)
+        {
+            SizeType numberOfKeys = end - begin;
+            InnerHashFunction innerHashFunction;
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials;
+            while (!chooseHashFunction(std::make_pair(begin, end), innerHashFunction, tableSize<SizeType>(tableFactor, numberOfKeys, numberOfKeys), policy.maxInnerLevelTrials, numberOfTrials))
+            {
+                escalateConstruction(tableFactor);
+            }
+            bucket.hash = innerHashFunction.hash;
+            bucket.offset = slots.size();
+            bucket.sizeOfSet = innerHashFunction.sizeOfSet;
+            slots.resize(slots.size() + bucket.sizeOfSet);
+            for (Iterator element = begin; element != end; ++element)
+            {
+                slots[bucket.offset + bucket.hash(*element)].key = *element;
+            }
+            // the empty slot of 0 gets a key hashing elsewhere, so that neither looks possible
+            if (numberOfKeys && slots[bucket.offset + bucket.hash(KeyType(0))].key == KeyType(0) && std::find(begin, end, KeyType(0)) == end)
+            {
+                KeyType placeholder = KeyType(1);
+                for (; bucket.hash(placeholder) == bucket.hash(KeyType(0)); ++placeholder);
+                slots[bucket.offset + bucket.hash(KeyType(0))].key = placeholder;
+            }
+        }
+        
+        /* Index of the slot of element, or slots.size() if it is not possible. */
+        inline SizeType slot(KeyType element) const
+        {
+            if (buckets.empty())
+            {
+                return slots.size();
+            }
+            Bucket const &bucket = buckets[hash(element)];
+            if (!bucket.sizeOfSet)
+            {
+                return slots.size();
+            }
+            SizeType index = bucket.offset + bucket.hash(element);
+            return (slots[index].key == element ? index : slots.size());
+        }
+        
+        inline SizeType checkPossibility(KeyType element) const
+        {
+            SizeType index = slot(element);
+            if (index == slots.size())
+            {
+                throw ImpossibleElementException(element);
+            }
+            return index;
+        }
+        
+        inline void setPresence(Slot &slot, bool present)
+        {
+            numberOfElements = numberOfElements + present - slot.present;
+            slot.present = present;
+        }
+    
+    public:
+        BasicPerfectHashMap() : sizeOfSet(0U), numberOfElements(0U), duplicatePolicy(DETECT_WHILE_HASHING)
+        {
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Makes elements possible, none present, with value-initialized values. */
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            numberOfElements = 0U;
+            std::vector<Bucket>().swap(buckets);
+            std::vector<Slot>().swap(slots);
+            if (keys.empty())
+            {
+                sizeOfSet = 0U;
+                return;
+            }
+            
+            chooseTopLevelHashFunction(keys);
+            SizeType offset = 0U;
+            for (auto &bucketOffset: bucketOffsets)
+            {
+                std::swap(offset, bucketOffset);
+                offset += bucketOffset;
+            }
+            std::vector<KeyType> partition(keys.size());
+            std::vector<SizeType> position(bucketOffsets.begin(), bucketOffsets.end() - 1);
+            for (auto const &element: keys)
+            {
+                partition[position[hash(element)]++] = element;
+            }
+            std::vector<SizeType>().swap(position);
+            
+            buckets.resize(sizeOfSet);
+            slots.reserve(3LLU * keys.size());
+            for (SizeType i = 0; i < sizeOfSet; ++i)
+            {
+                buildBucket(buckets[i], partition.begin() + bucketOffsets[i], partition.begin() + bucketOffsets[i + 1U]);
+            }
+            slots.shrink_to_fit();
+            std::vector<SizeType>().swap(bucketOffsets);
+        }
+        
+        /* Makes elements possible and present with their values; under REMOVE_DUPLICATES the last
+           value of an element wins. Throws std::invalid_argument, changing nothing, unless there is
+           one value per element. */
+        void init(std::vector<KeyType> const &elements, std::vector<ValueType> const &values)
+        {
+            if (values.size() != elements.size())
+            {
+                throw std::invalid_argument("one value per element is needed");
+            }
+            init(elements);
+            for (SizeType i = 0; i < elements.size(); ++i)
+            {
+                set(elements[i], values[i]);
+            }
+        }
+        
+        /* Value of a present element through value; returns false, leaving it alone, if the element
+           is absent. Throws ImpossibleElementException if it is not possible. */
+        bool get(KeyType element, ValueType &value) const
+        {
+            Slot const &elementSlot = slots[checkPossibility(element)];
+            if (elementSlot.present)
+            {
+                value = elementSlot.value;
+            }
+            return elementSlot.present;
+        }
+        
+        /* Makes element present with value. */
+        void set(KeyType element, ValueType const &value)
+        {
+            Slot &elementSlot = slots[checkPossibility(element)];
+            elementSlot.value = value;
+            setPresence(elementSlot, true);
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicPerfectHashMap) + buckets.capacity() * sizeof(Bucket) + slots.capacity() * sizeof(Slot);
+        }
+        
+        /* Makes element present with the value it had last. */
+        void insert(KeyType element)
+        {
+            setPresence(slots[checkPossibility(element)], true);
+        }
+        
+        void erase(KeyType element)
+        {
+            setPresence(slots[checkPossibility(element)], false);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return slots[checkPossibility(element)].present;
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slot(element) != slots.size();
+        }
+        
+        SizeType size() const
+        {
+            return numberOfElements;
+        }
+    };
+    
+    template<class ValueType>
+    using PerfectHashMap = BasicPerfectHashMap<unsigned int, unsigned int, ValueType, Hash>;
+    template<class ValueType>
+    using LargePerfectHashMap = BasicPerfectHashMap<unsigned long long, unsigned long long, ValueType, WideHash>;
+};
+
+#endif
@@ -34,7 +34,220 @@ int main(int argc, char **argv)
     parseArguments(argc, argv);
     
     NPerfectHash::PerfectHashSet FKS;
-    NPerfectHashTests::WorkingSet stdSet;
+    if (arguments.find("speculativeTrials") != arguments.end())
+    {
+        FKS.setNumberOfSpeculativeTrials(arguments["speculativeTrials"]);
+    }
+    NPerfectHash::ConstructionPolicy policy;
+    policy.maxTopLevelTrials = arguments["maxTopLevelTrials"];
+    policy.maxInnerLevelTrials = arguments["maxInnerLevelTrials"];
+    FKS.setConstructionPolicy(policy);
+    FKS.setLowMemoryConstruction(arguments.find("lowMemoryConstruction") != arguments.end());
+    FKS.setLazyConstruction(arguments.find("lazyConstruction") != arguments.end());
+    // the harness covers the FKS tables unless a flag asks for direct addressing or a linear scan
+    FKS.setDenseThreshold(arguments.find("denseThreshold") != arguments.end() ? arguments["denseThreshold"] : 0U);
+    FKS.setScanThreshold(arguments.find("scanThreshold") != arguments.end() ? arguments["scanThreshold"] : 0U);
+    bool fingerprints = (arguments.find("fingerprintBits") != arguments.end());
+    if (fingerprints)
+    {
+        FKS.setFingerprintBits(arguments["fingerprintBits"]);
+    }
+    NPerfectHashTests::FingerprintSet fingerprintSet(FKS, fingerprints ? std::min(std::max(arguments["fingerprintBits"], 4U), 16U) : 16U);
+    NPerfectHash::EDuplicatePolicy duplicatePolicy = NPerfectHash::DETECT_WHILE_HASHING;
+    if (arguments.find("throwOnDuplicates") != arguments.end())
+    {
+        duplicatePolicy = NPerfectHash::THROW_ON_DUPLICATES;
+    }
+    if (arguments.find("removeDuplicates") != arguments.end())
+    {
+        duplicatePolicy = NPerfectHash::REMOVE_DUPLICATES;
+    }
+    FKS.setDuplicatePolicy(duplicatePolicy);
+    NPerfectHash::BackgroundRebuildPerfectHashSet backgroundSet;
+    backgroundSet.setConstructionPolicy(policy);
+    backgroundSet.setDuplicatePolicy(duplicatePolicy);
+    bool chd = (arguments.find("chd") != arguments.end());
+    NPerfectHash::ChdSet chdSet;
+    chdSet.setConstructionPolicy(policy);
+    chdSet.setDuplicatePolicy(duplicatePolicy);
+    if (chd && arguments["chd"])
+    {
+        chdSet.setAverageBucketSize(arguments["chd"]);
+    }
+    bool ptHash = (arguments.find("ptHash") != arguments.end());
+    NPerfectHash::PtHashSet ptHashSet;
+    ptHashSet.setConstructionPolicy(policy);
+    ptHashSet.setDuplicatePolicy(duplicatePolicy);
+    if (ptHash && arguments["ptHash"])
+    {
+        ptHashSet.setBucketFactor(arguments["ptHash"]);
+    }
+    NPerfectHashTests::WorkingSet stdSet(arguments.find("removeDuplicates") != arguments.end());
+    bool externalConstruction = (arguments.find("externalConstruction") != arguments.end());
+    NPerfectHashTests::ExternalConstructionSet externalSet(".", externalConstruction ? arguments["externalConstruction"] : 1U);
+    NPerfectHashTests::LargeKeysSet largeKeysSet;
+    bool merge = (arguments.find("merge") != arguments.end());
+    NPerfectHashTests::MergedSet mergedSet(FKS, duplicatePolicy, merge && arguments["merge"] ? arguments["merge"] : 4U);
+    bool incrementalConstruction = (arguments.find("incrementalConstruction") != arguments.end());
+    NPerfectHashTests::IncrementalConstructionSet incrementalSet(FKS, incrementalConstruction ? arguments["incrementalConstruction"] : 1U);
+    bool bbHash = (arguments.find("bbHash") != arguments.end());
+    NPerfectHash::BbHashSet bbHashSet;
+    bbHashSet.setDuplicatePolicy(duplicatePolicy);
+    if (bbHash && arguments["bbHash"])
+    {
+        bbHashSet.setNumberOfThreads(arguments["bbHash"]);
+    }
+    if (arguments.find("gammaPercent") != arguments.end())
+    {
+        bbHashSet.setGamma(arguments["gammaPercent"] / 100.0);
+    }
+    bool recSplit = (arguments.find("recSplit") != arguments.end());
+    NPerfectHash::RecSplitSet recSplitSet;
+    recSplitSet.setDuplicatePolicy(duplicatePolicy);
+    if (recSplit && arguments["recSplit"])
+    {
+        recSplitSet.setLeafSize(arguments["recSplit"]);
+    }
+    bool dynamic = (arguments.find("dynamic") != arguments.end());
+    NPerfectHash::DynamicPerfectHashSet dynamicSet;
+    dynamicSet.setConstructionPolicy(policy);
+    dynamicSet.setDuplicatePolicy(duplicatePolicy);
+    NPerfectHashTests::DynamicUniverseSet<NPerfectHash::DynamicPerfectHashSet> dynamicUniverseSet(dynamicSet);
+    bool cuckoo = (arguments.find("cuckoo") != arguments.end());
+    NPerfectHash::CuckooSet cuckooSet;
+    cuckooSet.setDuplicatePolicy(duplicatePolicy);
+    if (cuckoo && arguments["cuckoo"])
+    {
+        cuckooSet.setMaxLoadFactor(arguments["cuckoo"] / 100.0);
+    }
+    NPerfectHashTests::DynamicUniverseSet<NPerfectHash::CuckooSet> cuckooUniverseSet(cuckooSet);
+    bool direct = (arguments.find("direct") != arguments.end());
+    NPerfectHash::DirectSet directSet;
+    directSet.setDuplicatePolicy(duplicatePolicy);
+    bool scan = (arguments.find("scan") != arguments.end());
+    NPerfectHash::ScanSet scanSet;
+    scanSet.setDuplicatePolicy(duplicatePolicy);
+    bool autoSelection = (arguments.find("auto") != arguments.end());
+    NPerfectHash::AutoSet autoSet;
+    autoSet.setDuplicatePolicy(duplicatePolicy);
+    autoSet.setTarget(static_cast<NPerfectHash::ETarget>(arguments["auto"]), arguments["byteBudget"]);
+    bool fuseFilter = (arguments.find("fuseFilter") != arguments.end());
+    NPerfectHash::PrefilteredPerfectHashSet prefilteredSet;
+    prefilteredSet.getSet().setConstructionPolicy(policy);
+    prefilteredSet.getSet().setDuplicatePolicy(duplicatePolicy);
+    prefilteredSet.getSet().setDenseThreshold(0.0);
+    prefilteredSet.getSet().setScanThreshold(0U);
+    bool retrieval = (arguments.find("retrieval") != arguments.end());
+    NPerfectHash::Retrieval retrievalEngine;
+    if (retrieval && arguments["retrieval"])
+    {
+        retrievalEngine.setValueBits(arguments["retrieval"]);
+    }
+    NPerfectHashTests::RetrievalSet retrievalSet(retrievalEngine, arguments.find("removeDuplicates") != arguments.end());
+    bool map = (arguments.find("map") != arguments.end());
+    NPerfectHash::PerfectHashMap<unsigned long long> perfectHashMap;
+    perfectHashMap.setConstructionPolicy(policy);
+    perfectHashMap.setDuplicatePolicy(duplicatePolicy);
+    NPerfectHashTests::MapSet mapSet(perfectHashMap);
+    bool monotone = (arguments.find("monotone") != arguments.end());
+    NPerfectHash::MonotoneSet monotoneSet;
+    monotoneSet.setDuplicatePolicy(duplicatePolicy);
+    NPerfectHashTests::OrderedQueriesSet orderedQueriesSet(monotoneSet);
+    if (arguments.find("bucketSize") != arguments.end())
+    {
+        recSplitSet.setBucketSize(arguments["bucketSize"]);
+        monotoneSet.setBucketSize(arguments["bucketSize"]);
+    }
+    NPerfectHash::ISet *testedSet = &FKS;
+    if (fingerprints)
+    {
+        testedSet = &fingerprintSet;
+    }
+    if (externalConstruction)
+    {
+        testedSet = &externalSet;
+    }
+    if (arguments.find("largeKeys") != arguments.end())
+    {
+        testedSet = &largeKeysSet;
+    }
+#ifdef __SIZEOF_INT128__
+    NPerfectHashTests::HugeKeysSet hugeKeysSet;
+    if (arguments.find("hugeKeys") != arguments.end())
+    {
+        testedSet = &hugeKeysSet;
+    }
+#endif
+    if (incrementalConstruction)
+    {
+        testedSet = &incrementalSet;
+    }
+    if (merge)
+    {
+        testedSet = &mergedSet;
+    }
+    if (arguments.find("backgroundRebuild") != arguments.end())
+    {
+        testedSet = &backgroundSet;
+    }
+    if (chd)
+    {
+        testedSet = &chdSet;
+    }
+    if (ptHash)
+    {
+        testedSet = &ptHashSet;
+    }
+    if (bbHash)
+    {
+        testedSet = &bbHashSet;
+    }
+    if (recSplit)
+    {
+        testedSet = &recSplitSet;
+    }
+    if (monotone)
+    {
+        testedSet = &orderedQueriesSet;
+    }
+    if (dynamic)
+    {
+        testedSet = &dynamicUniverseSet;
+    }
+    if (cuckoo)
+    {
+        testedSet = &cuckooUniverseSet;
+    }
+    if (direct)
+    {
+        testedSet = &directSet;
+    }
+    if (scan)
+    {
+        testedSet = &scanSet;
+    }
+    if (autoSelection)
+    {
+        testedSet = &autoSet;
+    }
+    if (fuseFilter)
+    {
+        testedSet = &prefilteredSet;
+    }
+    if (retrieval)
+    {
+        testedSet = &retrievalSet;
+    }
+    if (map)
+    {
+        testedSet = &mapSet;
+    }
+    if (arguments["typeOfTest"] == 14U)
+    {
+        // no set under test: the size arithmetic, plus a PerfectHashSet of -largeCount keys when asked for
+        NPerfectHashTests::testSizeLimits(arguments["largeCount"]);
+        return 0;
+    }
     NPerfectHashTests::ITest *testCase;
 
     switch (arguments["typeOfTest"])
@@ -72,14 +285,85 @@ int main(int argc, char **argv)
     if (arguments.find("timeMeasure") != arguments.end())
     {
         clock_t begin = clock();
-        NPerfectHashTests::test(*testCase, &FKS, NULL);
+        NPerfectHashTests::test(*testCase, testedSet, NULL);
         clock_t end = clock();
         printf("Execution time:          %.10lf\n", (double)(end - begin) / CLOCKS_PER_SEC);
         printf("Average execution time:  %.10lf\n", (double)(end - begin) / CLOCKS_PER_SEC / arguments["numberOfTests"]);
     }
     else
     {
-        NPerfectHashTests::test(*testCase, &FKS, &stdSet);
+        NPerfectHashTests::test(*testCase, testedSet, &stdSet);
+    }
+    if (arguments.find("constructionStatistics") != arguments.end())
+    {
+        NPerfectHash::ConstructionStatistics const &statistics = FKS.getConstructionStatistics();
+        printf("Top level trials:        %llu\n", statistics.topLevelTrials);
+        printf("Top level fallbacks:     %u\n", statistics.topLevelFallbacks);
+        printf("Top level table factor:  %u\n", statistics.topLevelTableFactor);
+        printf("Inner level trials:      %llu\n", statistics.innerLevelTrials);
+        printf("Max inner level trials:  %u\n", statistics.maxInnerLevelTrials);
+        printf("Inner level fallbacks:   %u\n", statistics.innerLevelFallbacks);
+        printf("Max inner table factor:  %u\n", statistics.maxInnerLevelTableFactor);
+        printf("Equal elements checks:   %u\n", statistics.equalElementsChecks);
+        printf("Peak construction bytes: %llu\n", statistics.peakConstructionBytes);
+        printf("Memory usage bytes:      %llu\n", FKS.memoryUsage());
+        printf("Direct addressing:       %s\n", FKS.getEngine() == NPerfectHash::DIRECT_ENGINE ? "yes" : "no");
+        printf("Linear scan:             %s\n", FKS.getEngine() == NPerfectHash::SCAN_ENGINE ? "yes" : "no");
+    }
+    if (arguments.find("memoryUsage") != arguments.end())
+    {
+        if (chd)
+        {
+            NPerfectHashTests::printMemoryUsage(chdSet);
+        }
+        if (ptHash)
+        {
+            NPerfectHashTests::printMemoryUsage(ptHashSet);
+        }
+        if (bbHash)
+        {
+            NPerfectHashTests::printMemoryUsage(bbHashSet);
+        }
+        if (recSplit)
+        {
+            NPerfectHashTests::printMemoryUsage(recSplitSet);
+        }
+        if (monotone)
+        {
+            NPerfectHashTests::printMemoryUsage(monotoneSet);
+        }
+        if (dynamic)
+        {
+            NPerfectHashTests::printMemoryUsage(dynamicSet);
+        }
+        if (cuckoo)
+        {
+            NPerfectHashTests::printMemoryUsage(cuckooSet);
+        }
+        if (direct)
+        {
+            printf("Memory usage bytes:      %llu\n", directSet.memoryUsage());
+        }
+        if (autoSelection)
+        {
+            printf("Selected engine:         %u\n", static_cast<unsigned int>(autoSet.getEngine()));
+            printf("Estimated bytes:         %llu\n", autoSet.getEstimatedBytes());
+            printf("Memory usage bytes:      %llu\n", autoSet.memoryUsage());
+        }
+        if (fuseFilter)
+        {
+            printf("Memory usage bytes:      %llu\n", prefilteredSet.memoryUsage());
+            printf("Filter bytes:            %llu\n", prefilteredSet.getFilter().memoryUsage());
+        }
+        if (map)
+        {
+            printf("Memory usage bytes:      %llu\n", perfectHashMap.memoryUsage());
+        }
+        if (retrieval)
+        {
+            printf("Memory usage bytes:      %llu\n", retrievalEngine.memoryUsage());
+            printf("Overhead bits per key:   %.3lf\n", retrievalEngine.overheadBitsPerKey());
+        }
     }
     delete testCase;
     return 0;
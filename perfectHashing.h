@@ -6,21 +6,157 @@
 #include <cstdlib>
 #include <cassert>
 #include <climits>
+#include <limits>
 #include <string>
 #include <algorithm>
+#include <istream>
+#include <ostream>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
 #include "testlib.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace NPerfectHash
 {
-    class ISet
+    class StorageException: public std::exception
     {
+        std::string messageTemplate;
+    public:
+        explicit StorageException(std::string const &what)
+        {
+            messageTemplate = "Storage failure: " + what + "\n";
+        }
+        virtual const char* what() const throw()
+        {
+            return messageTemplate.c_str();
+        }
+    };
+    
+    template<class ValueType>
+    inline void writeValues(std::ostream &out, ValueType const *values, unsigned long long count)
+    {
+        if (!out.write(reinterpret_cast<char const *>(values), count * sizeof(ValueType)))
+        {
+            throw StorageException("cannot write");
+        }
+    }
+    
+    template<class ValueType>
+    inline void readValues(std::istream &in, ValueType *values, unsigned long long count)
+    {
+        if (!in.read(reinterpret_cast<char *>(values), count * sizeof(ValueType)))
+        {
+            throw StorageException("unexpected end of data");
+        }
+    }
+    
+    template<class ValueType>
+    inline void writeValue(std::ostream &out, ValueType const &value)
+    {
+        writeValues(out, &value, 1LLU);
+    }
+    
+    template<class ValueType>
+    inline ValueType readValue(std::istream &in)
+    {
+        ValueType value;
+        readValues(in, &value, 1LLU);
+        return value;
+    }
+    
+    template<class KeyType, class SizeType>
+    class IBasicSet
+    {
+    public:
+        virtual void insert(KeyType) = 0;
+        virtual void erase(KeyType) = 0;
+        virtual bool find(KeyType) const = 0;
+        virtual bool isPossible(KeyType) const = 0;
+        virtual void init(std::vector<KeyType> const &) = 0;
+        virtual SizeType size() const = 0;
+    };
+    
+    typedef IBasicSet<unsigned int, unsigned int> ISet;
+    typedef IBasicSet<unsigned long long, unsigned long long> ILargeSet;
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 HugeKey; // 128-bit keys such as UUIDs
+    typedef IBasicSet<HugeKey, unsigned long long> IHugeSet;
+#endif
+    
+    /* Unsigned key type of twice the width of PartType. */
+    template<unsigned int PartBytes>
+    struct CompositeKeyType;
+    
+    template<>
+    struct CompositeKeyType<4U>
+    {
+        typedef unsigned long long Type;
+    };
+    
+#ifdef __SIZEOF_INT128__
+    template<>
+    struct CompositeKeyType<8U>
+    {
+        typedef HugeKey Type;
+    };
+#endif
+    
+    /* Composite keys, such as (uint32, uint32) edges, packed losslessly into one key of twice the
+       width, first part in the high half. */
+    template<class PartType>
+    inline typename CompositeKeyType<sizeof(PartType)>::Type compositeKey(PartType first, PartType second)
+    {
+        static_assert(std::is_unsigned<PartType>::value, "composite key parts must be unsigned");
+        return (static_cast<typename CompositeKeyType<sizeof(PartType)>::Type>(first) << (sizeof(PartType) * CHAR_BIT)) | second;
+    }
+    
+    /* max - min of keys, saturated to ULLONG_MAX for keys wider than 64 bits. */
+    template<class KeyType>
+    inline unsigned long long keySpan(KeyType minKey, KeyType maxKey)
+    {
+        KeyType span = maxKey - minKey;
+        return (span > KeyType(ULLONG_MAX) ? ULLONG_MAX : static_cast<unsigned long long>(span));
+    }
+    
+    /* Xor of the 64-bit words of a key, for 64-bit mixing of any key width. */
+    template<class KeyType>
+    inline unsigned long long foldKey(KeyType key)
+    {
+        unsigned long long folded = static_cast<unsigned long long>(key);
+        for (unsigned int shift = 64U; shift < sizeof(KeyType) * CHAR_BIT; shift += 64U)
+        {
+            folded ^= static_cast<unsigned long long>(key >> shift);
+        }
+        return folded;
+    }
+    
+    /* Generator of hash coefficients and seeds on the calling thread: testlib's rnd unless a
+       ThreadGeneratorScope installed another one. */
+    inline random_t *&threadGenerator()
+    {
+        static thread_local random_t *generator = &rnd;
+        return generator;
+    }
+    
+    /* Makes the calling thread draw hash coefficients and seeds from generator while in scope, so
+       that a set can be built on one thread while others build theirs from rnd. */
+    class ThreadGeneratorScope
+    {
+        random_t *previous;
     public:
-        virtual void insert(unsigned int) = 0;
-        virtual void erase(unsigned int) = 0;
-        virtual bool find(unsigned int) const = 0;
-        virtual bool isPossible(unsigned int) const = 0;
-        virtual void init(std::vector<unsigned int> const &) = 0;
-        virtual unsigned int size() const = 0;
+        explicit ThreadGeneratorScope(random_t &generator) : previous(threadGenerator())
+        {
+            threadGenerator() = &generator;
+        }
+        
+        ~ThreadGeneratorScope()
+        {
+            threadGenerator() = previous;
+        }
     };
     
     class Hash
@@ -31,10 +167,28 @@ namespace NPerfectHash
         unsigned int sizeOfSet;
         
     public:
+        Hash() : firstHashCoefficient(1LLU), secondHashCoefficient(0LLU), sizeOfSet(1U)
+        {
+        }
+        
+        void save(std::ostream &out) const
+        {
+            writeValue(out, firstHashCoefficient);
+            writeValue(out, secondHashCoefficient);
+            writeValue(out, sizeOfSet);
+        }
+        
+        void load(std::istream &in)
+        {
+            firstHashCoefficient = readValue<unsigned long long>(in);
+            secondHashCoefficient = readValue<unsigned long long>(in);
+            sizeOfSet = readValue<unsigned int>(in);
+        }
+        
         inline void generateNewCoefficients()
         {
-            firstHashCoefficient = rnd.next(1LLU, PRIME - 1LLU); 
-            secondHashCoefficient = rnd.next(0LLU, PRIME - 1LLU);
+            firstHashCoefficient = threadGenerator()->next(1LLU, PRIME - 1LLU); 
+            secondHashCoefficient = threadGenerator()->next(0LLU, PRIME - 1LLU);
         }
         
         inline void setSize(unsigned int size)
@@ -42,247 +196,1953 @@ namespace NPerfectHash
             sizeOfSet = size;
         }
         
-        inline unsigned int operator()(unsigned int key) const
+        inline unsigned int operator()(unsigned int key) const
+        {
+            return (((((firstHashCoefficient >> 32LLU) << 32LLU) * key) % PRIME + ((firstHashCoefficient & UINT_MAX) * key) % PRIME + secondHashCoefficient) % PRIME) % sizeOfSet;
+        }
+    };
+    
+    static const unsigned long long MERSENNE_PRIME = (1LLU << 61LLU) - 1LLU;
+    
+    inline unsigned long long reduceMersenne(unsigned long long value)
+    {
+        value = (value & MERSENNE_PRIME) + (value >> 61LLU);
+        return (value >= MERSENNE_PRIME ? value - MERSENNE_PRIME : value);
+    }
+    
+    /* a, b < 2^61; the 128-bit product is folded using 2^61 = 1 (mod MERSENNE_PRIME). */
+    inline unsigned long long multiplyMersenne(unsigned long long a, unsigned long long b)
+    {
+        unsigned long long aHigh = a >> 32LLU, aLow = a & UINT_MAX;
+        unsigned long long bHigh = b >> 32LLU, bLow = b & UINT_MAX;
+        unsigned long long low = aLow * bLow;
+        unsigned long long middle = aHigh * bLow + aLow * bHigh;
+        return reduceMersenne(((aHigh * bHigh) << 3LLU) + (middle >> 29LLU) + ((middle & ((1LLU << 29LLU) - 1LLU)) << 32LLU) + (low >> 61LLU) + (low & MERSENNE_PRIME));
+    }
+    
+    /* Hash of 64-bit keys into 64-bit table sizes: (a * low + b * high + c) mod (2^61 - 1),
+       where low and high are the 32-bit halves of the key. */
+    class WideHash
+    {
+        static const unsigned long long PRIME = MERSENNE_PRIME;
+        unsigned long long firstHashCoefficient;
+        unsigned long long secondHashCoefficient;
+        unsigned long long thirdHashCoefficient;
+        unsigned long long sizeOfSet;
+        
+        static inline unsigned long long reduce(unsigned long long value)
+        {
+            return reduceMersenne(value);
+        }
+        
+        static inline unsigned long long multiply(unsigned long long a, unsigned long long b)
+        {
+            return multiplyMersenne(a, b);
+        }
+        
+    public:
+        WideHash() : firstHashCoefficient(1LLU), secondHashCoefficient(1LLU), thirdHashCoefficient(0LLU), sizeOfSet(1LLU)
+        {
+        }
+        
+        void save(std::ostream &out) const
+        {
+            writeValue(out, firstHashCoefficient);
+            writeValue(out, secondHashCoefficient);
+            writeValue(out, thirdHashCoefficient);
+            writeValue(out, sizeOfSet);
+        }
+        
+        void load(std::istream &in)
+        {
+            firstHashCoefficient = readValue<unsigned long long>(in);
+            secondHashCoefficient = readValue<unsigned long long>(in);
+            thirdHashCoefficient = readValue<unsigned long long>(in);
+            sizeOfSet = readValue<unsigned long long>(in);
+        }
+        
+        inline void generateNewCoefficients()
+        {
+            firstHashCoefficient = threadGenerator()->next(1LLU, PRIME - 1LLU);
+            secondHashCoefficient = threadGenerator()->next(1LLU, PRIME - 1LLU);
+            thirdHashCoefficient = threadGenerator()->next(0LLU, PRIME - 1LLU);
+        }
+        
+        inline void setSize(unsigned long long size)
+        {
+            sizeOfSet = size;
+        }
+        
+        inline unsigned long long operator()(unsigned long long key) const
+        {
+            return reduce(multiply(firstHashCoefficient, key & UINT_MAX) + multiply(secondHashCoefficient, key >> 32LLU) + thirdHashCoefficient) % sizeOfSet;
+        }
+    };
+    
+    /* WideHash for keys of any width: (c + sum of a_i * w_i) mod (2^61 - 1) over the 32-bit words w_i
+       of the key, one coefficient per word, so no key bit is folded away before hashing; a 128-bit
+       key costs four multiplications. */
+    template<class KeyType>
+    class MultilinearHash
+    {
+        static const unsigned int WORDS = (sizeof(KeyType) + 3U) / 4U;
+        unsigned long long coefficients[WORDS + 1U]; // constant term last
+        unsigned long long sizeOfSet;
+        
+    public:
+        MultilinearHash() : sizeOfSet(1LLU)
+        {
+            std::fill(coefficients, coefficients + WORDS, 1LLU);
+            coefficients[WORDS] = 0LLU;
+        }
+        
+        void save(std::ostream &out) const
+        {
+            writeValues(out, coefficients, WORDS + 1U);
+            writeValue(out, sizeOfSet);
+        }
+        
+        void load(std::istream &in)
+        {
+            readValues(in, coefficients, WORDS + 1U);
+            sizeOfSet = readValue<unsigned long long>(in);
+        }
+        
+        inline void generateNewCoefficients()
+        {
+            for (unsigned int i = 0; i < WORDS; ++i)
+            {
+                coefficients[i] = threadGenerator()->next(1LLU, MERSENNE_PRIME - 1LLU);
+            }
+            coefficients[WORDS] = threadGenerator()->next(0LLU, MERSENNE_PRIME - 1LLU);
+        }
+        
+        inline void setSize(unsigned long long size)
+        {
+            sizeOfSet = size;
+        }
+        
+        inline unsigned long long operator()(KeyType key) const
+        {
+            unsigned long long sum = coefficients[WORDS];
+            for (unsigned int i = 0; i < WORDS; ++i)
+            {
+                sum = reduceMersenne(sum + multiplyMersenne(coefficients[i], static_cast<unsigned long long>(key >> (32U * i)) & UINT_MAX));
+            }
+            return sum % sizeOfSet;
+        }
+    };
+    
+    /* Trial budgets are per level and per escalation step; 0 means unbounded. */
+    struct ConstructionPolicy
+    {
+        unsigned int maxTopLevelTrials;
+        unsigned int maxInnerLevelTrials;
+        
+        ConstructionPolicy() : maxTopLevelTrials(0U), maxInnerLevelTrials(0U)
+        {
+        }
+    };
+    
+    struct ConstructionStatistics
+    {
+        unsigned long long topLevelTrials;
+        unsigned long long innerLevelTrials;
+        unsigned int maxInnerLevelTrials;
+        unsigned int topLevelFallbacks;
+        unsigned int innerLevelFallbacks;
+        unsigned int topLevelTableFactor;
+        unsigned int maxInnerLevelTableFactor;
+        unsigned int equalElementsChecks; // extra passes over the keys looking for equal elements
+        unsigned long long peakConstructionBytes; // owned by the set, the caller's vector is not counted
+        
+        ConstructionStatistics()
+        {
+            clear();
+        }
+        
+        void clear()
+        {
+            topLevelTrials = innerLevelTrials = 0LLU;
+            maxInnerLevelTrials = topLevelFallbacks = innerLevelFallbacks = 0U;
+            topLevelTableFactor = maxInnerLevelTableFactor = 1U;
+            equalElementsChecks = 0U;
+            peakConstructionBytes = 0LLU;
+        }
+        
+        void updatePeakConstructionBytes(unsigned long long bytes)
+        {
+            peakConstructionBytes = std::max(peakConstructionBytes, bytes);
+        }
+    };
+    
+    /* Called when a level ran out of its trial budget: a table twice as large makes a hash function
+       more likely to pass. */
+    inline void escalateConstruction(unsigned int &tableFactor)
+    {
+        tableFactor *= 2U;
+    }
+    
+    /* Returns false if maxNumberOfTrials hash functions were rejected. */
+    template<class SetType, class ElementsType, class SizeType>
+    inline bool chooseHashFunction(ElementsType const &elements, SetType &hashSet, SizeType sizeOfSet, unsigned int maxNumberOfTrials, unsigned int &numberOfTrials)
+    {
+        hashSet.sizeOfSet = sizeOfSet;
+        hashSet.hash.setSize(hashSet.sizeOfSet);
+        numberOfTrials = 0U;
+        
+        do
+        {
+            if (maxNumberOfTrials && numberOfTrials == maxNumberOfTrials)
+            {
+                return false;
+            }
+            ++numberOfTrials;
+            hashSet.hash.generateNewCoefficients();
+        }
+        while (hashSet.isBadHashFunction(elements));
+        return true;
+    }
+        
+    class EqualElementsException: public std::exception
+    {
+        std::string messageTemplate;
+    public:
+        unsigned long long whichElement;
+        explicit EqualElementsException(unsigned long long element) : whichElement(element) 
+        {
+            messageTemplate = "There are two or more instances of " + std::to_string(element) + " element\n";
+        }
+        virtual const char* what() const throw()
+        {
+            return messageTemplate.c_str();
+        }
+    };
+    
+    class ImpossibleElementException: public std::exception
+    {
+        std::string messageTemplate;
+    public:
+        unsigned long long whichElement;
+        explicit ImpossibleElementException(unsigned long long element) : whichElement(element)
+        {
+            messageTemplate = "No support of " + std::to_string(element) + " element\n";
+        }
+        virtual const char* what() const throw()
+        {
+            return messageTemplate.c_str();
+        }
+    };
+    
+    enum EDuplicatePolicy
+    {
+        DETECT_WHILE_HASHING, // duplicates throw EqualElementsException from the hash function search
+        THROW_ON_DUPLICATES,  // one pass before any hashing throws EqualElementsException
+        REMOVE_DUPLICATES     // one pass before any hashing silently keeps the first instance
+    };
+    
+    /* LSD radix sort with 8-bit digits. */
+    template<class KeyType>
+    inline void radixSort(std::vector<KeyType> &keys)
+    {
+        std::vector<KeyType> buffer(keys.size());
+        for (unsigned int shift = 0U; shift < sizeof(KeyType) * CHAR_BIT; shift += 8U)
+        {
+            std::vector<std::size_t> position(256U, 0U);
+            for (auto const &key: keys)
+            {
+                ++position[(key >> shift) & 255U];
+            }
+            if (std::count(position.begin(), position.end(), keys.size()))
+            {
+                continue; // every key has the same digit
+            }
+            std::size_t offset = 0U;
+            for (auto &digitPosition: position)
+            {
+                std::swap(offset, digitPosition);
+                offset += digitPosition;
+            }
+            for (auto const &key: keys)
+            {
+                buffer[position[(key >> shift) & 255U]++] = key;
+            }
+            keys.swap(buffer);
+        }
+    }
+    
+    /* Returns whether elements contain equal ones; with throwOnDuplicate it throws EqualElementsException
+       instead, otherwise uniqueElements receives one instance of each. Dense ranges (at most
+       DENSITY_FACTOR values per element) are checked with a bitmap, others with a radix sort. */
+    template<class KeyType>
+    inline bool findDuplicates(std::vector<KeyType> const &elements, bool throwOnDuplicate, std::vector<KeyType> &uniqueElements)
+    {
+        static const unsigned long long DENSITY_FACTOR = 32LLU;
+        if (elements.empty())
+        {
+            return false;
+        }
+        
+        KeyType minElement = *std::min_element(elements.begin(), elements.end());
+        KeyType maxElement = *std::max_element(elements.begin(), elements.end());
+        if (keySpan(minElement, maxElement) / DENSITY_FACTOR < elements.size())
+        {
+            std::vector<bool> seen(static_cast<std::size_t>(maxElement - minElement) + 1U, false);
+            bool hasDuplicates = false;
+            uniqueElements.clear();
+            for (auto const &element: elements)
+            {
+                if (!seen[element - minElement])
+                {
+                    seen[element - minElement] = true;
+                    if (!throwOnDuplicate)
+                    {
+                        uniqueElements.push_back(element);
+                    }
+                }
+                else if (throwOnDuplicate)
+                {
+                    throw EqualElementsException(element);
+                }
+                else
+                {
+                    hasDuplicates = true;
+                }
+            }
+            return hasDuplicates;
+        }
+        
+        std::vector<KeyType> sortedElements(elements);
+        radixSort(sortedElements);
+        typename std::vector<KeyType>::iterator duplicate = std::adjacent_find(sortedElements.begin(), sortedElements.end());
+        if (duplicate == sortedElements.end())
+        {
+            return false;
+        }
+        if (throwOnDuplicate)
+        {
+            throw EqualElementsException(*duplicate);
+        }
+        sortedElements.erase(std::unique(duplicate, sortedElements.end()), sortedElements.end());
+        uniqueElements.swap(sortedElements);
+        return true;
+    }
+    
+    class SizeOverflowException: public std::exception
+    {
+        std::string messageTemplate;
+    public:
+        explicit SizeOverflowException(unsigned long long numberOfElements)
+        {
+            messageTemplate = "Table for " + std::to_string(numberOfElements) + " elements does not fit the size type\n";
+        }
+        virtual const char* what() const throw()
+        {
+            return messageTemplate.c_str();
+        }
+    };
+    
+    /* factor * numberOfElements * multiplier, checked against the range of SizeType. */
+    template<class SizeType>
+    inline SizeType tableSize(unsigned long long factor, unsigned long long numberOfElements, unsigned long long multiplier)
+    {
+        unsigned long long const limit = std::numeric_limits<SizeType>::max();
+        if (numberOfElements && multiplier && (factor > limit / numberOfElements || factor * numberOfElements > limit / multiplier))
+        {
+            throw SizeOverflowException(numberOfElements);
+        }
+        return factor * numberOfElements * multiplier;
+    }
+    
+    /* sum += x * x, saturating instead of wrapping, so that huge buckets always reject a hash function. */
+    inline void addSquare(unsigned long long &sum, unsigned long long x)
+    {
+        if (x > UINT_MAX || sum > ULLONG_MAX - x * x)
+        {
+            sum = ULLONG_MAX;
+            return;
+        }
+        sum += x * x;
+    }
+    
+    /* Direct addressing over [minimal key, maximal key]: bit key - minimal key of a possibility bitmap
+       and of a presence bitmap, with no hash at all. The bitmaps are interleaved word by word, so find()
+       reads one word pair. Memory is two bits per value of the key range, which pays off only for
+       dense keys; BasicPerfectHashSet picks it when keys are dense enough, see setDenseThreshold(). */
+    template<class KeyType, class SizeType>
+    class BasicDirectSet: public IBasicSet<KeyType, SizeType>
+    {
+        EDuplicatePolicy duplicatePolicy;
+        KeyType minimalKey;
+        unsigned long long span;
+        std::vector<unsigned long long> words; // possibility word, then presence word, for every 64 values
+        SizeType numberOfElements;
+        
+        inline bool isPossibleOffset(unsigned long long currentOffset) const
+        {
+            return currentOffset < span && ((words[(currentOffset >> 6LLU) << 1LLU] >> (currentOffset & 63LLU)) & 1LLU);
+        }
+        
+        inline unsigned long long checkPossibility(KeyType element) const
+        {
+            unsigned long long currentOffset = keySpan(minimalKey, element);
+            if (!isPossibleOffset(currentOffset))
+            {
+                throw ImpossibleElementException(element);
+            }
+            return currentOffset;
+        }
+        
+        inline void setPresence(unsigned long long currentOffset, bool present)
+        {
+            unsigned long long &word = words[((currentOffset >> 6LLU) << 1LLU) + 1LLU];
+            unsigned long long mask = 1LLU << (currentOffset & 63LLU);
+            numberOfElements = numberOfElements + present - static_cast<bool>(word & mask);
+            word = (present ? word | mask : word & ~mask);
+        }
+    
+    public:
+        BasicDirectSet() : duplicatePolicy(DETECT_WHILE_HASHING), minimalKey(0), span(0LLU), numberOfElements(0U)
+        {
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Number of values from the minimal to the maximal key, both included. */
+        inline unsigned long long getSpan() const
+        {
+            return span;
+        }
+        
+        /* Equal elements are found on the bitmap, so no policy needs a separate duplicate pass. */
+        void init(std::vector<KeyType> const &elements)
+        {
+            numberOfElements = 0U;
+            span = 0LLU;
+            words.clear();
+            if (elements.empty())
+            {
+                return;
+            }
+            std::pair<typename std::vector<KeyType>::const_iterator, typename std::vector<KeyType>::const_iterator> bounds =
+                std::minmax_element(elements.begin(), elements.end());
+            minimalKey = *bounds.first;
+            unsigned long long maximalOffset = keySpan(minimalKey, *bounds.second);
+            if (maximalOffset / 128LLU >= words.max_size() / 2LLU)
+            {
+                throw SizeOverflowException(elements.size());
+            }
+            span = maximalOffset + 1LLU;
+            words.assign((maximalOffset / 64LLU + 1LLU) * 2LLU, 0LLU);
+            for (auto const &element: elements)
+            {
+                unsigned long long currentOffset = keySpan(minimalKey, element);
+                unsigned long long &word = words[(currentOffset >> 6LLU) << 1LLU];
+                unsigned long long mask = 1LLU << (currentOffset & 63LLU);
+                if ((word & mask) && duplicatePolicy != REMOVE_DUPLICATES)
+                {
+                    throw EqualElementsException(element);
+                }
+                word |= mask;
+            }
+        }
+        
+        /* Calls action(key) for every possible key in increasing order, with whether it is present. */
+        template<class Action>
+        void forEachPossible(Action action) const
+        {
+            for (unsigned long long i = 0; i < words.size(); i += 2LLU)
+            {
+                for (unsigned long long bits = words[i]; bits; bits &= bits - 1LLU)
+                {
+                    unsigned int bit = __builtin_ctzll(bits);
+                    action(static_cast<KeyType>(minimalKey + ((i >> 1LLU) << 6LLU) + bit), static_cast<bool>((words[i + 1LLU] >> bit) & 1LLU));
+                }
+            }
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicDirectSet) + words.capacity() * sizeof(unsigned long long);
+        }
+        
+        void insert(KeyType element)
+        {
+            setPresence(checkPossibility(element), true);
+        }
+        
+        void erase(KeyType element)
+        {
+            setPresence(checkPossibility(element), false);
+        }
+        
+        bool find(KeyType element) const
+        {
+            unsigned long long currentOffset = checkPossibility(element);
+            return (words[((currentOffset >> 6LLU) << 1LLU) + 1LLU] >> (currentOffset & 63LLU)) & 1LLU;
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return isPossibleOffset(keySpan(minimalKey, element));
+        }
+        
+        SizeType size() const
+        {
+            return numberOfElements;
+        }
+    };
+    
+    typedef BasicDirectSet<unsigned int, unsigned int> DirectSet;
+    typedef BasicDirectSet<unsigned long long, unsigned long long> LargeDirectSet;
+    
+    /* Bit i is set if keys[i] == element, for i < count; the scalar loop serves key types without a SIMD overload. */
+    template<class KeyType>
+    inline unsigned int matchMask(KeyType const *keys, unsigned int count, KeyType element)
+    {
+        unsigned int mask = 0U;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            mask |= static_cast<unsigned int>(keys[i] == element) << i;
+        }
+        return mask;
+    }
+    
+#ifdef __SSE2__
+    /* keys are 16-byte aligned and readable up to count rounded up to 4 keys. */
+    inline unsigned int matchMask(unsigned int const *keys, unsigned int count, unsigned int element)
+    {
+        __m128i broadcast = _mm_set1_epi32(static_cast<int>(element));
+        unsigned int mask = 0U;
+        for (unsigned int i = 0; i < count; i += 4U)
+        {
+            __m128i equal = _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<__m128i const *>(keys + i)), broadcast);
+            mask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(equal))) << i;
+        }
+        return mask & (count < 32U ? (1U << count) - 1U : UINT_MAX);
+    }
+    
+    /* SSE2 has no 64-bit compare: both 32-bit halves of a key must match. */
+    inline unsigned int matchMask(unsigned long long const *keys, unsigned int count, unsigned long long element)
+    {
+        __m128i broadcast = _mm_set1_epi64x(static_cast<long long>(element));
+        unsigned int mask = 0U;
+        for (unsigned int i = 0; i < count; i += 2U)
+        {
+            __m128i equal = _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<__m128i const *>(keys + i)), broadcast);
+            equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+            mask |= static_cast<unsigned int>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << i;
+        }
+        return mask & (count < 32U ? (1U << count) - 1U : UINT_MAX);
+    }
+#endif
+    
+    /* Up to MAX_KEYS keys in an inline 16-byte aligned array, answered by comparing the element with
+       all of them at once through matchMask(): no hashing and no heap, for sets too small to repay
+       building hash tables. BasicPerfectHashSet picks it below setScanThreshold() keys. */
+    template<class KeyType, class SizeType>
+    class BasicScanSet: public IBasicSet<KeyType, SizeType>
+    {
+    public:
+        static const unsigned int MAX_KEYS = 32U;
+        
+    private:
+        EDuplicatePolicy duplicatePolicy;
+        alignas(16) KeyType keys[MAX_KEYS];
+        unsigned int numberOfKeys;
+        unsigned int presence; // bit i for keys[i]
+        
+        inline unsigned int checkPossibility(KeyType element) const
+        {
+            unsigned int mask = matchMask(keys, numberOfKeys, element);
+            if (!mask)
+            {
+                throw ImpossibleElementException(element);
+            }
+            return __builtin_ctz(mask);
+        }
+        
+    public:
+        BasicScanSet() : duplicatePolicy(DETECT_WHILE_HASHING), numberOfKeys(0U), presence(0U)
+        {
+            std::fill(keys, keys + MAX_KEYS, KeyType(0));
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* Throws SizeOverflowException above MAX_KEYS distinct elements. */
+        void init(std::vector<KeyType> const &elements)
+        {
+            numberOfKeys = 0U;
+            presence = 0U;
+            for (auto const &element: elements)
+            {
+                if (matchMask(keys, numberOfKeys, element))
+                {
+                    if (duplicatePolicy != REMOVE_DUPLICATES)
+                    {
+                        throw EqualElementsException(element);
+                    }
+                    continue;
+                }
+                if (numberOfKeys == MAX_KEYS)
+                {
+                    numberOfKeys = 0U;
+                    throw SizeOverflowException(elements.size());
+                }
+                keys[numberOfKeys++] = element;
+            }
+        }
+        
+        /* Calls action(key, present) for every possible key in init() order. */
+        template<class Action>
+        void forEachPossible(Action action) const
+        {
+            for (unsigned int i = 0; i < numberOfKeys; ++i)
+            {
+                action(keys[i], static_cast<bool>((presence >> i) & 1U));
+            }
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicScanSet);
+        }
+        
+        void insert(KeyType element)
+        {
+            presence |= 1U << checkPossibility(element);
+        }
+        
+        void erase(KeyType element)
+        {
+            presence &= ~(1U << checkPossibility(element));
+        }
+        
+        bool find(KeyType element) const
+        {
+            return (presence >> checkPossibility(element)) & 1U;
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return matchMask(keys, numberOfKeys, element) != 0U;
+        }
+        
+        SizeType size() const
+        {
+            return __builtin_popcount(presence);
+        }
+    };
+    
+    typedef BasicScanSet<unsigned int, unsigned int> ScanSet;
+    typedef BasicScanSet<unsigned long long, unsigned long long> LargeScanSet;
+    
+    /* Engine behind a BasicPerfectHashSet after init(). */
+    enum EEngine
+    {
+        FKS_ENGINE,    // two-level hashing
+        DIRECT_ENGINE,     // BasicDirectSet over dense keys
+        SCAN_ENGINE,       // BasicScanSet over a few keys
+        FINGERPRINT_ENGINE // two-level hashing with fingerprints in flat arrays, see setFingerprintBits()
+    };
+    
+    template<class KeyType, class SizeType, class HashType>
+    class BasicExternalPerfectHashBuilder;
+    
+    template<class KeyType, class SizeType, class HashType>
+    class BasicIncrementalBuilder;
+    
+    /* FKS two-level scheme. KeyType and SizeType are unsigned integers, HashType maps KeyType into
+       [0, size) for a size of SizeType; see the PerfectHashSet and LargePerfectHashSet typedefs. */
+    template<class KeyType, class SizeType, class HashType>
+    class BasicPerfectHashSet: public IBasicSet<KeyType, SizeType>
+    { 
+        friend BasicExternalPerfectHashBuilder<KeyType, SizeType, HashType>;
+        friend BasicIncrementalBuilder<KeyType, SizeType, HashType>;
+        
+        /* merge() keeps the top-level hash while the inner tables stay within this many slots per
+           bucket: a few bytes each next to the header of every inner set. */
+        static const unsigned long long MERGE_SLOTS_PER_BUCKET = 8LLU;
+        
+        template<class ValueType>
+        static unsigned long long bytesOf(std::vector<ValueType> const &elements)
+        {
+            return elements.capacity() * sizeof(ValueType);
+        }
+        
+        struct InnerHashSet
+        {
+            std::vector<bool> presence;
+            std::vector<KeyType> hashElement;
+            
+            HashType hash;
+            SizeType sizeOfSet;
+            
+            InnerHashSet() : sizeOfSet(0U)
+            {
+            }
+            
+            InnerHashSet(std::vector<KeyType> const &elements, unsigned int maxNumberOfTrials, ConstructionStatistics &statistics)
+            {
+                init(elements, maxNumberOfTrials, statistics);
+            }
+            
+            explicit InnerHashSet(std::istream &in)
+            {
+                load(in);
+            }
+            
+            inline bool isBadHashFunction(std::vector<KeyType> const &elements)
+            {
+                presence.assign(sizeOfSet, false);
+                hashElement.assign(sizeOfSet, 0U);
+                for (auto const &element: elements)
+                {
+                    SizeType currentHash = hash(element);
+                    
+                    if (presence[currentHash])
+                    {
+                        if (hashElement[currentHash] == element)
+                        {
+                            throw EqualElementsException(element);
+                        }
+                        return true;
+                    }
+                    
+                    hashElement[currentHash] = element;
+                    presence[currentHash] = true;
+                }
+                
+                return false;
+            }
+            
+            template<class SetType, class ElementsType, class TableSizeType>
+            friend bool chooseHashFunction(ElementsType const &, SetType &, TableSizeType, unsigned int, unsigned int &);
+            
+            inline void init(std::vector<KeyType> const &elements, unsigned int maxNumberOfTrials, ConstructionStatistics &statistics)
+            {
+                unsigned int tableFactor = 1U;
+                unsigned int numberOfTrials, totalNumberOfTrials = 0U;
+                while (!chooseHashFunction(elements, *this, tableSize<SizeType>(tableFactor, elements.size(), elements.size()), maxNumberOfTrials, numberOfTrials))
+                {
+                    totalNumberOfTrials += numberOfTrials;
+                    ++statistics.innerLevelFallbacks;
+                    escalateConstruction(tableFactor);
+                }
+                totalNumberOfTrials += numberOfTrials;
+                statistics.innerLevelTrials += totalNumberOfTrials;
+                statistics.maxInnerLevelTrials = std::max(statistics.maxInnerLevelTrials, totalNumberOfTrials);
+                statistics.maxInnerLevelTableFactor = std::max(statistics.maxInnerLevelTableFactor, tableFactor);
+                
+                presence.assign(sizeOfSet, false);
+                if (elements.size() && hashElement[hash(KeyType(0))] == KeyType(0) && std::count(elements.begin(), elements.end(), KeyType(0)) == 0)
+                {
+                    // the empty slot of 0 gets a key hashing elsewhere, so that neither looks possible
+                    KeyType placeholder = KeyType(1);
+                    for (; hash(placeholder) == hash(KeyType(0)); ++placeholder);
+                    hashElement[hash(KeyType(0))] = placeholder;
+                }
+            }
+            
+            inline void checkPossibility(KeyType element) const
+            {
+                if (!isPossible(element))
+                {
+                    throw ImpossibleElementException(element);
+                }
+            }
+            
+            inline bool operate(KeyType element, bool operationType) // 1 - insert, 0 - remove;
+            {
+                checkPossibility(element);
+                bool result = operationType ^ presence[hash(element)];
+                presence[hash(element)] = operationType;
+                return result;
+            }
+            
+            bool insert(KeyType element)
+            {
+                return operate(element, 1);
+            }
+            
+            bool erase(KeyType element)
+            {
+                return operate(element, 0);
+            }
+            
+            bool find(KeyType element) const
+            {           
+                checkPossibility(element);
+                return presence[hash(element)];
+            }
+            
+            bool isPossible(KeyType element) const
+            {
+                return (presence.size() && hashElement[hash(element)] == element);
+            }
+            
+            /* Whether slot holds a key, which then hashes to it; the placeholder of an absent 0 never does. */
+            inline bool isOccupied(SizeType slot) const
+            {
+                return hash(hashElement[slot]) == slot;
+            }
+            
+            template<class Action>
+            void forEachPossible(Action action) const
+            {
+                for (SizeType slot = 0; slot < sizeOfSet; ++slot)
+                {
+                    if (isOccupied(slot))
+                    {
+                        action(hashElement[slot], static_cast<bool>(presence[slot]));
+                    }
+                }
+            }
+            
+            SizeType numberOfKeys() const
+            {
+                SizeType keys = 0U;
+                forEachPossible([&keys](KeyType, bool)
+                                {
+                                    ++keys;
+                                }
+                );
+                return keys;
+            }
+            
+            /* Whether the new keys [begin, end) all hash to distinct free slots. */
+            template<class Iterator>
+            bool fits(Iterator begin, Iterator end) const
+            {
+                if (!sizeOfSet)
+                {
+                    return false;
+                }
+                std::vector<SizeType> slots;
+                for (Iterator key = begin; key != end; ++key)
+                {
+                    slots.push_back(hash(key->first));
+                    if (isOccupied(slots.back()))
+                    {
+                        return false;
+                    }
+                }
+                std::sort(slots.begin(), slots.end());
+                return std::adjacent_find(slots.begin(), slots.end()) == slots.end();
+            }
+            
+            /* Writes keys that fit() into their slots; returns how many of them are present. */
+            template<class Iterator>
+            SizeType place(Iterator begin, Iterator end)
+            {
+                SizeType present = 0U;
+                for (Iterator key = begin; key != end; ++key)
+                {
+                    hashElement[hash(key->first)] = key->first;
+                    presence[hash(key->first)] = key->second;
+                    present += key->second;
+                }
+                return present;
+            }
+            
+            unsigned long long memoryUsage() const
+            {
+                return sizeof(InnerHashSet) + presence.capacity() / CHAR_BIT + bytesOf(hashElement);
+            }
+            
+            /* sizeOfSet, hash, hashElement, presence packed into bytes. */
+            void save(std::ostream &out) const
+            {
+                writeValue(out, sizeOfSet);
+                if (!sizeOfSet)
+                {
+                    return;
+                }
+                hash.save(out);
+                writeValues(out, hashElement.data(), sizeOfSet);
+                std::vector<unsigned char> packedPresence((sizeOfSet + CHAR_BIT - 1U) / CHAR_BIT, 0U);
+                for (SizeType i = 0; i < sizeOfSet; ++i)
+                {
+                    packedPresence[i / CHAR_BIT] |= presence[i] << (i % CHAR_BIT);
+                }
+                writeValues(out, packedPresence.data(), packedPresence.size());
+            }
+            
+            void load(std::istream &in)
+            {
+                sizeOfSet = readValue<SizeType>(in);
+                presence.assign(sizeOfSet, false);
+                hashElement.assign(sizeOfSet, 0U);
+                if (!sizeOfSet)
+                {
+                    return;
+                }
+                hash.load(in);
+                readValues(in, hashElement.data(), sizeOfSet);
+                std::vector<unsigned char> packedPresence((sizeOfSet + CHAR_BIT - 1U) / CHAR_BIT);
+                readValues(in, packedPresence.data(), packedPresence.size());
+                for (SizeType i = 0; i < sizeOfSet; ++i)
+                {
+                    presence[i] = (packedPresence[i / CHAR_BIT] >> (i % CHAR_BIT)) & 1U;
+                }
+            }
+        };
+        
+        /* Fingerprint mode: the inner tables of all buckets in flat arrays, as the slots of
+           BasicPerfectHashMap. A bucket is its hash, the offset of its slots and their number; a slot is
+           a bits-wide fingerprint, packed with 2 bytes of slack so that any fingerprint is read through
+           one 3-byte window, and a presence bit. Fingerprints are never 0, which marks empty slots. */
+        struct FingerprintTable
+        {
+            struct Bucket
+            {
+                HashType hash;
+                SizeType offset;
+                SizeType sizeOfSet;
+            };
+            
+            std::vector<Bucket> buckets;
+            std::vector<unsigned char> fingerprints;
+            std::vector<bool> presence;
+            unsigned int bits;
+            
+            FingerprintTable() : bits(0U)
+            {
+            }
+            
+            inline unsigned int fingerprintOf(KeyType element) const
+            {
+                unsigned int fingerprint = (foldKey(element) * 0x9E3779B97F4A7C15LLU) >> (64U - bits);
+                return (fingerprint ? fingerprint : 1U);
+            }
+            
+            inline unsigned int fingerprintAt(unsigned long long slot) const
+            {
+                unsigned long long bit = slot * bits;
+                unsigned char const *bytes = fingerprints.data() + (bit >> 3U);
+                unsigned int window = bytes[0] | (bytes[1] << 8U) | (bytes[2] << 16U);
+                return (window >> (bit & 7U)) & ((1U << bits) - 1U);
+            }
+            
+            /* Reserves room for the given buckets and slots, so that append() does not reallocate. */
+            void clear(unsigned int newBits, SizeType numberOfBuckets, unsigned long long numberOfSlots)
+            {
+                bits = newBits;
+                std::vector<Bucket>().swap(buckets);
+                buckets.reserve(numberOfBuckets);
+                std::vector<unsigned char>().swap(fingerprints);
+                fingerprints.reserve((numberOfSlots * bits + 7U) / 8U + 2U);
+                fingerprints.assign(2U, 0U);
+                std::vector<bool>().swap(presence);
+                presence.reserve(numberOfSlots);
+            }
+            
+            /* Appends the next bucket, taking the fingerprints of the keys of its exact inner table. */
+            void append(InnerHashSet const &innerHashSet)
+            {
+                Bucket bucket;
+                bucket.hash = innerHashSet.hash;
+                bucket.offset = presence.size();
+                bucket.sizeOfSet = innerHashSet.sizeOfSet;
+                buckets.push_back(bucket);
+                presence.insert(presence.end(), innerHashSet.presence.begin(), innerHashSet.presence.end());
+                fingerprints.resize((static_cast<unsigned long long>(presence.size()) * bits + 7U) / 8U + 2U, 0U);
+                for (SizeType slot = 0; slot < bucket.sizeOfSet; ++slot)
+                {
+                    if (innerHashSet.isOccupied(slot))
+                    {
+                        unsigned long long bit = (static_cast<unsigned long long>(bucket.offset) + slot) * bits;
+                        unsigned int window = fingerprintOf(innerHashSet.hashElement[slot]) << (bit & 7U);
+                        for (unsigned int i = 0; i < 3U; ++i)
+                        {
+                            fingerprints[(bit >> 3U) + i] |= (window >> (8U * i)) & 0xFFU;
+                        }
+                    }
+                }
+            }
+            
+            /* Slot of element in the given bucket, or presence.size() if its fingerprint is not there. */
+            inline unsigned long long slot(SizeType bucketIndex, KeyType element) const
+            {
+                Bucket const &bucket = buckets[bucketIndex];
+                if (!bucket.sizeOfSet)
+                {
+                    return presence.size();
+                }
+                unsigned long long index = static_cast<unsigned long long>(bucket.offset) + bucket.hash(element);
+                return (fingerprintAt(index) == fingerprintOf(element) ? index : presence.size());
+            }
+            
+            inline unsigned long long checkPossibility(SizeType bucketIndex, KeyType element) const
+            {
+                unsigned long long index = slot(bucketIndex, element);
+                if (index == presence.size())
+                {
+                    throw ImpossibleElementException(element);
+                }
+                return index;
+            }
+            
+            inline bool operate(SizeType bucketIndex, KeyType element, bool operationType) // 1 - insert, 0 - remove;
+            {
+                unsigned long long index = checkPossibility(bucketIndex, element);
+                bool result = operationType ^ presence[index];
+                presence[index] = operationType;
+                return result;
+            }
+            
+            bool find(SizeType bucketIndex, KeyType element) const
+            {
+                return presence[checkPossibility(bucketIndex, element)];
+            }
+            
+            bool isPossible(SizeType bucketIndex, KeyType element) const
+            {
+                return slot(bucketIndex, element) != presence.size();
+            }
+            
+            unsigned long long memoryUsage() const
+            {
+                return sizeof(FingerprintTable) + bytesOf(buckets) + bytesOf(fingerprints) + presence.capacity() / CHAR_BIT;
+            }
+        };
+        
+        /* Lazy construction of the last init(); the mutex serializes the builds of pending buckets. */
+        struct LazyConstructionState
+        {
+            std::unique_ptr<std::atomic<bool>[]> innerHashSetsBuilt;
+            SizeType numberOfBuiltInnerHashSets;
+            std::mutex mutex;
+        };
+        
+        mutable std::vector<InnerHashSet> innerHashSets; // filled on first touch by lazy construction
+        FingerprintTable fingerprintTable; // replaces innerHashSets in fingerprint mode
+        std::vector<std::vector<KeyType> > innerSetsElements;
+        mutable std::vector<SizeType> innerSetsOffsets;    // low memory and lazy construction: bucket sizes, then prefix sums
+        mutable std::vector<KeyType> partitionedElements; // low memory and lazy construction: elements grouped by bucket
+        std::unique_ptr<LazyConstructionState> lazyState; // only after a lazy init(), while buckets may be pending
+        HashType hash;
+        SizeType sizeOfSet;
+        SizeType numberOfElements;
+        unsigned int numberOfSpeculativeTrials;
+        bool lowMemoryConstruction;
+        bool lazyConstruction;
+        EDuplicatePolicy duplicatePolicy;
+        ConstructionPolicy policy;
+        mutable ConstructionStatistics statistics;
+        BasicDirectSet<KeyType, SizeType> directSet;
+        BasicScanSet<KeyType, SizeType> scanSet;
+        EEngine engine;
+        double denseThreshold;
+        unsigned int scanThreshold;
+        unsigned int fingerprintBits;
+        
+        inline bool usesPartition() const
+        {
+            return lowMemoryConstruction || lazyConstruction;
+        }
+        
+        inline void checkEqualityAndThrowExceptionIfEqual(KeyType firstElement, KeyType secondElement) const
+        {
+            if (firstElement == secondElement)
+            {
+                throw EqualElementsException(firstElement);
+            }
+        }
+        
+        inline void distributeElements(std::vector<KeyType> const &elements)
+        {
+            innerSetsElements.assign(sizeOfSet, std::vector<KeyType> ());
+            
+            for (auto const &element: elements)
+            {
+                innerSetsElements[hash(element)].push_back(element);
+            }
+        }
+        
+        unsigned long long innerSetsElementsBytes() const
+        {
+            unsigned long long bytes = innerSetsElements.capacity() * sizeof(std::vector<KeyType>);
+            for (auto const &setElements: innerSetsElements)
+            {
+                bytes += bytesOf(setElements);
+            }
+            return bytes;
+        }
+        
+        /* Only reached with a rejected hash function: equal elements share a bucket and keep
+           every hash function bad, so look for them in the largest bucket. */
+        inline void checkLargestInnerSetForEqualElements(std::vector<KeyType> const &elements)
+        {
+            ++statistics.equalElementsChecks;
+            SizeType largestInnerSet = std::max_element(innerSetsOffsets.begin(), innerSetsOffsets.end()) - innerSetsOffsets.begin();
+            std::vector<KeyType> setElements;
+            setElements.reserve(innerSetsOffsets[largestInnerSet]);
+            for (auto const &element: elements)
+            {
+                if (hash(element) == largestInnerSet)
+                {
+                    setElements.push_back(element);
+                }
+            }
+            statistics.updatePeakConstructionBytes(bytesOf(innerSetsOffsets) + bytesOf(setElements));
+            
+            std::sort(setElements.begin(), setElements.end());
+            for (SizeType i = 1; i < setElements.size(); ++i)
+            {
+                checkEqualityAndThrowExceptionIfEqual(setElements[i - 1], setElements[i]);
+            }
+        }
+        
+        inline bool isBadHashFunctionByCounting(std::vector<KeyType> const &elements)
+        {
+            innerSetsOffsets.assign(sizeOfSet + 1U, 0U);
+            statistics.updatePeakConstructionBytes(bytesOf(innerSetsOffsets));
+            
+            for (auto const &element: elements)
+            {
+                ++innerSetsOffsets[hash(element)];
+            }
+            
+            unsigned long long sumOfSquaresOfInnerSetSizes = 0;
+            for (auto const &innerSetSize: innerSetsOffsets)
+            {
+                addSquare(sumOfSquaresOfInnerSetSizes, innerSetSize);
+            }
+            
+            if (sumOfSquaresOfInnerSetSizes > 3LLU * sizeOfSet)
+            {
+                checkLargestInnerSetForEqualElements(elements);
+                return true;
+            }
+            return false;
+        }
+        
+        /* Counting sort of elements by bucket into one flat array. */
+        inline void partitionElements(std::vector<KeyType> const &elements)
+        {
+            SizeType offset = 0U;
+            for (auto &innerSetOffset: innerSetsOffsets)
+            {
+                std::swap(offset, innerSetOffset);
+                offset += innerSetOffset;
+            }
+            
+            partitionedElements.resize(elements.size());
+            std::vector<SizeType> position(innerSetsOffsets.begin(), innerSetsOffsets.end() - 1);
+            statistics.updatePeakConstructionBytes(bytesOf(innerSetsOffsets) + bytesOf(partitionedElements) + bytesOf(position));
+            for (auto const &element: elements)
+            {
+                partitionedElements[position[hash(element)]++] = element;
+            }
+        }
+        
+        inline bool isBadHashFunction(std::vector<KeyType> const &elements)
+        {
+            if (usesPartition())
+            {
+                return isBadHashFunctionByCounting(elements);
+            }
+            
+            distributeElements(elements);
+            statistics.updatePeakConstructionBytes(innerSetsElementsBytes());
+            
+            unsigned long long sumOfSquaresOfInnerSetSizes = 0;
+            
+            for (auto const &setElements: innerSetsElements)
+            {
+                for (SizeType i = 1; i < setElements.size(); ++i)
+                {
+                    checkEqualityAndThrowExceptionIfEqual(setElements[i - 1], setElements[i]);
+                }
+                if (setElements.size() == 3U)
+                {
+                    checkEqualityAndThrowExceptionIfEqual(setElements.front(), setElements.back());
+                }
+                addSquare(sumOfSquaresOfInnerSetSizes, setElements.size());
+            }
+            return (sumOfSquaresOfInnerSetSizes > 3LLU * sizeOfSet);
+        }
+        
+        
+        /* Draws numberOfSpeculativeTrials candidates and measures all of them in one pass over elements;
+           keeps the first one whose sum of squares fits into the bound. If none does, hash and
+           innerSetsOffsets are left at the candidate with the smallest sum. */
+        inline bool trySpeculativeHashFunctions(std::vector<KeyType> const &elements)
+        {
+            std::vector<HashType> candidates(numberOfSpeculativeTrials, hash);
+            std::vector<std::vector<SizeType> > innerSetsSizes(numberOfSpeculativeTrials, std::vector<SizeType> (sizeOfSet + 1U, 0U));
+            statistics.updatePeakConstructionBytes(numberOfSpeculativeTrials * bytesOf(innerSetsSizes.front()));
+            
+            for (auto &candidate: candidates)
+            {
+                candidate.generateNewCoefficients();
+            }
+            
+            for (auto const &element: elements)
+            {
+                for (unsigned int i = 0; i < numberOfSpeculativeTrials; ++i)
+                {
+                    ++innerSetsSizes[i][candidates[i](element)];
+                }
+            }
+            
+            unsigned int best = 0U;
+            unsigned long long bestSumOfSquares = ULLONG_MAX;
+            for (unsigned int i = 0; i < numberOfSpeculativeTrials; ++i)
+            {
+                unsigned long long sumOfSquaresOfInnerSetSizes = 0;
+                for (auto const &innerSetSize: innerSetsSizes[i])
+                {
+                    addSquare(sumOfSquaresOfInnerSetSizes, innerSetSize);
+                }
+                if (sumOfSquaresOfInnerSetSizes <= 3LLU * sizeOfSet)
+                {
+                    hash = candidates[i];
+                    innerSetsOffsets.swap(innerSetsSizes[i]);
+                    return true;
+                }
+                if (sumOfSquaresOfInnerSetSizes < bestSumOfSquares)
+                {
+                    best = i;
+                    bestSumOfSquares = sumOfSquaresOfInnerSetSizes;
+                }
+            }
+            
+            hash = candidates[best];
+            innerSetsOffsets.swap(innerSetsSizes[best]);
+            return false;
+        }
+        
+        inline bool chooseSpeculativeHashFunction(std::vector<KeyType> const &elements, SizeType sizeOfSet, unsigned int maxNumberOfTrials, unsigned int &numberOfTrials)
+        {
+            this->sizeOfSet = sizeOfSet;
+            hash.setSize(sizeOfSet);
+            numberOfTrials = 0U;
+            
+            for (unsigned int failedRounds = 0U; ; ++failedRounds)
+            {
+                if (maxNumberOfTrials && numberOfTrials >= maxNumberOfTrials)
+                {
+                    return false;
+                }
+                numberOfTrials += numberOfSpeculativeTrials;
+                if (trySpeculativeHashFunctions(elements))
+                {
+                    break;
+                }
+                // equal elements would never let a candidate pass: look for them after 1, 2, 4, ... failed rounds
+                if (!(failedRounds & (failedRounds + 1U)))
+                {
+                    checkLargestInnerSetForEqualElements(elements);
+                }
+            }
+            
+            if (!usesPartition())
+            {
+                distributeElements(elements);
+                statistics.updatePeakConstructionBytes(innerSetsElementsBytes());
+            }
+            return true;
+        }
+        
+        inline void chooseTopLevelHashFunction(std::vector<KeyType> const &elements)
+        {
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials;
+            
+            while (numberOfSpeculativeTrials > 1U && elements.size() ? 
+                   !chooseSpeculativeHashFunction(elements, tableSize<SizeType>(tableFactor, elements.size(), 1LLU), policy.maxTopLevelTrials, numberOfTrials) :
+                   !chooseHashFunction(elements, *this, tableSize<SizeType>(tableFactor, elements.size(), 1LLU), policy.maxTopLevelTrials, numberOfTrials))
+            {
+                statistics.topLevelTrials += numberOfTrials;
+                ++statistics.topLevelFallbacks;
+                escalateConstruction(tableFactor);
+            }
+            statistics.topLevelTrials += numberOfTrials;
+            statistics.topLevelTableFactor = tableFactor;
+        }
+        
+        /* Bucket copies are released as soon as their inner table is built. */
+        inline void fillInnerHashSets()
+        {
+            innerHashSets.clear();
+            innerHashSets.reserve(sizeOfSet);
+            
+            unsigned long long innerHashSetsBytes = innerHashSets.capacity() * sizeof(InnerHashSet);
+            unsigned long long elementsBytes = innerSetsElementsBytes();
+            
+            for (auto &elements: innerSetsElements)
+            {
+                innerHashSets.emplace_back(elements, policy.maxInnerLevelTrials, statistics);
+                innerHashSetsBytes += innerHashSets.back().memoryUsage() - sizeof(InnerHashSet);
+                statistics.updatePeakConstructionBytes(innerHashSetsBytes + elementsBytes);
+                elementsBytes -= bytesOf(elements);
+                std::vector<KeyType>().swap(elements);
+            }
+            std::vector<std::vector<KeyType> >().swap(innerSetsElements);
+        }
+        
+        inline void fillInnerHashSetsFromPartition()
+        {
+            innerHashSets.clear();
+            innerHashSets.reserve(sizeOfSet);
+            
+            unsigned long long innerHashSetsBytes = innerHashSets.capacity() * sizeof(InnerHashSet);
+            unsigned long long elementsBytes = bytesOf(innerSetsOffsets) + bytesOf(partitionedElements);
+            std::vector<KeyType> elements;
+            
+            for (SizeType i = 0; i < sizeOfSet; ++i)
+            {
+                elements.assign(partitionedElements.begin() + innerSetsOffsets[i], partitionedElements.begin() + innerSetsOffsets[i + 1]);
+                innerHashSets.emplace_back(elements, policy.maxInnerLevelTrials, statistics);
+                innerHashSetsBytes += innerHashSets.back().memoryUsage() - sizeof(InnerHashSet);
+                statistics.updatePeakConstructionBytes(innerHashSetsBytes + elementsBytes + bytesOf(elements));
+            }
+            std::vector<KeyType>().swap(partitionedElements);
+            std::vector<SizeType>().swap(innerSetsOffsets);
+        }
+        
+        inline void prepareLazyInnerHashSets()
+        {
+            innerHashSets.assign(sizeOfSet, InnerHashSet());
+            lazyState.reset(new LazyConstructionState());
+            lazyState->innerHashSetsBuilt.reset(new std::atomic<bool>[sizeOfSet]);
+            for (SizeType i = 0; i < sizeOfSet; ++i)
+            {
+                lazyState->innerHashSetsBuilt[i].store(false, std::memory_order_relaxed);
+            }
+            lazyState->numberOfBuiltInnerHashSets = 0U;
+            statistics.updatePeakConstructionBytes(bytesOf(innerSetsOffsets) + bytesOf(partitionedElements) + innerHashSets.capacity() * (sizeof(InnerHashSet) + sizeof(std::atomic<bool>)));
+        }
+        
+        inline void buildInnerHashSet(SizeType bucket) const
         {
-            return (((((firstHashCoefficient >> 32LLU) << 32LLU) * key) % PRIME + ((firstHashCoefficient & UINT_MAX) * key) % PRIME + secondHashCoefficient) % PRIME) % sizeOfSet;
+            std::lock_guard<std::mutex> lock(lazyState->mutex);
+            if (lazyState->innerHashSetsBuilt[bucket].load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            
+            std::vector<KeyType> elements(partitionedElements.begin() + innerSetsOffsets[bucket], partitionedElements.begin() + innerSetsOffsets[bucket + 1]);
+            innerHashSets[bucket].init(elements, policy.maxInnerLevelTrials, statistics);
+            lazyState->innerHashSetsBuilt[bucket].store(true, std::memory_order_release);
+            
+            if (++lazyState->numberOfBuiltInnerHashSets == sizeOfSet)
+            {
+                std::vector<KeyType>().swap(partitionedElements);
+                std::vector<SizeType>().swap(innerSetsOffsets);
+            }
         }
-    };
-    
-    template<class SetType>
-    inline void chooseHashFunction(std::vector<unsigned int> const &elements, SetType &hashSet, unsigned int (*sizeConversion) (unsigned int))
-    {
-        hashSet.sizeOfSet = sizeConversion(elements.size());
-        hashSet.hash.setSize(hashSet.sizeOfSet);
         
-        do
+        /* Bucket of element; an FKS table without buckets, as after init() of no elements, has
+           no possible keys. */
+        inline SizeType touch(KeyType element) const
         {
-            hashSet.hash.generateNewCoefficients();
+            if (!sizeOfSet)
+            {
+                throw ImpossibleElementException(element);
+            }
+            SizeType bucket = hash(element);
+            if (lazyState && !lazyState->innerHashSetsBuilt[bucket].load(std::memory_order_acquire))
+            {
+                buildInnerHashSet(bucket);
+            }
+            return bucket;
         }
-        while (hashSet.isBadHashFunction(elements));
-    }
         
-    class EqualElementsException: public std::exception
-    {
-        std::string messageTemplate;
-    public:
-        unsigned int whichElement;
-        explicit EqualElementsException(unsigned int element) : whichElement(element) 
+        inline void buildPendingInnerHashSets() const
         {
-            messageTemplate = "There are two or more instances of " + std::to_string(element) + " element\n";
+            for (SizeType i = 0; lazyState && i < sizeOfSet; ++i)
+            {
+                if (!lazyState->innerHashSetsBuilt[i].load(std::memory_order_acquire))
+                {
+                    buildInnerHashSet(i);
+                }
+            }
         }
-        virtual const char* what() const throw()
+        
+        /* Fingerprint mode: moves the exact inner tables into fingerprintTable, bucket by bucket. */
+        inline void packFingerprints()
         {
-            return messageTemplate.c_str();
+            buildPendingInnerHashSets();
+            lazyState.reset();
+            unsigned long long innerHashSetsBytes = innerHashSets.capacity() * sizeof(InnerHashSet);
+            unsigned long long numberOfSlots = 0LLU;
+            for (auto const &innerHashSet: innerHashSets)
+            {
+                innerHashSetsBytes += innerHashSet.memoryUsage() - sizeof(InnerHashSet);
+                numberOfSlots += innerHashSet.sizeOfSet;
+            }
+            fingerprintTable.clear(fingerprintBits, sizeOfSet, numberOfSlots);
+            for (auto const &innerHashSet: innerHashSets)
+            {
+                fingerprintTable.append(innerHashSet);
+            }
+            statistics.updatePeakConstructionBytes(innerHashSetsBytes + fingerprintTable.memoryUsage());
+            std::vector<InnerHashSet>().swap(innerHashSets);
+            engine = FINGERPRINT_ENGINE;
         }
-    };
-    
-    class ImpossibleElementException: public std::exception
-    {
-        std::string messageTemplate;
-    public:
-        unsigned int whichElement;
-        explicit ImpossibleElementException(unsigned int element) : whichElement(element)
+        
+        template<class SetType, class ElementsType, class TableSizeType>
+        friend bool chooseHashFunction(ElementsType const &, SetType &, TableSizeType, unsigned int, unsigned int &);
+        
+        inline bool isDense(std::vector<KeyType> const &elements) const
         {
-            messageTemplate = "No support of " + std::to_string(element) + " element\n";
+            if (elements.empty() || denseThreshold <= 0.0)
+            {
+                return false;
+            }
+            std::pair<typename std::vector<KeyType>::const_iterator, typename std::vector<KeyType>::const_iterator> bounds =
+                std::minmax_element(elements.begin(), elements.end());
+            return keySpan(*bounds.first, *bounds.second) < denseThreshold * elements.size();
         }
-        virtual const char* what() const throw()
+        
+        /* Direct addressing and scanning have no image of their own: writes the FKS image of the same keys. */
+        template<class EngineType>
+        void saveAsFks(EngineType const &engineSet, std::ostream &out) const
         {
-            return messageTemplate.c_str();
+            std::vector<KeyType> keys;
+            std::vector<KeyType> presentKeys;
+            engineSet.forEachPossible([&keys, &presentKeys](KeyType key, bool present)
+                                      {
+                                          keys.push_back(key);
+                                          if (present)
+                                          {
+                                              presentKeys.push_back(key);
+                                          }
+                                      }
+            );
+            BasicPerfectHashSet fks;
+            fks.setDenseThreshold(0.0);
+            fks.setScanThreshold(0U);
+            fks.setConstructionPolicy(policy);
+            fks.init(keys);
+            for (auto const &key: presentKeys)
+            {
+                fks.insert(key);
+            }
+            fks.save(out);
         }
-    };
     
-    class PerfectHashSet: public ISet
-    { 
-        static unsigned long long square(unsigned int x)
+        inline bool hasBuckets() const
         {
-            return 1llu * x * x;
+            return engine == FKS_ENGINE && !innerHashSets.empty();
         }
         
-        struct InnerHashSet
+        /* Merges keys, possible keys with presence and none possible here yet, into the current buckets.
+           Returns false, changing nothing, if the inner tables would take more than
+           MERGE_SLOTS_PER_BUCKET slots per bucket; otherwise every bucket whose new keys do not fit
+           into free slots of its inner table is rebuilt from its old and new keys. */
+        bool mergeIntoBuckets(std::vector<std::pair<KeyType, bool> > const &keys)
         {
-            std::vector<bool> presence;
-            std::vector<unsigned int> hashElement;
-            
-            Hash hash;
-            unsigned int sizeOfSet;
-            
-            InnerHashSet(std::vector<unsigned int> const &elements)
+            std::vector<SizeType> offsets(sizeOfSet + 1U, 0U);
+            for (auto const &key: keys)
+            {
+                ++offsets[hash(key.first)];
+            }
+            SizeType offset = 0U;
+            for (auto &bucketOffset: offsets)
+            {
+                std::swap(offset, bucketOffset);
+                offset += bucketOffset;
+            }
+            std::vector<std::pair<KeyType, bool> > partition(keys.size());
+            std::vector<SizeType> position(offsets.begin(), offsets.end() - 1);
+            for (auto const &key: keys)
             {
-                init(elements);
+                partition[position[hash(key.first)]++] = key;
             }
+            statistics.updatePeakConstructionBytes(bytesOf(offsets) + bytesOf(partition) + bytesOf(position));
             
-            inline bool isBadHashFunction(std::vector<unsigned int> const &elements)
+            std::vector<bool> rebuilt(sizeOfSet, false);
+            unsigned long long slots = 0LLU;
+            for (SizeType bucket = 0; bucket < sizeOfSet; ++bucket)
             {
-                presence.assign(sizeOfSet, false);
-                hashElement.assign(sizeOfSet, 0U);
-                for (auto const &element: elements)
+                InnerHashSet const &innerHashSet = innerHashSets[bucket];
+                unsigned long long keysAdded = offsets[bucket + 1U] - offsets[bucket];
+                if (!keysAdded || innerHashSet.fits(partition.begin() + offsets[bucket], partition.begin() + offsets[bucket + 1U]))
                 {
-                    unsigned int currentHash = hash(element);
-                    
-                    if (presence[currentHash])
-                    {
-                        if (hashElement[currentHash] == element)
-                        {
-                            throw EqualElementsException(element);
-                        }
-                        return true;
-                    }
-                    
-                    hashElement[currentHash] = element;
-                    presence[currentHash] = true;
+                    slots += innerHashSet.sizeOfSet;
+                    continue;
                 }
-                
+                unsigned long long bucketKeys = innerHashSet.numberOfKeys() + keysAdded;
+                slots += bucketKeys * bucketKeys;
+                rebuilt[bucket] = true;
+            }
+            if (slots > MERGE_SLOTS_PER_BUCKET * sizeOfSet)
+            {
                 return false;
             }
             
-            friend void chooseHashFunction<InnerHashSet>(std::vector<unsigned int> const &, InnerHashSet &, unsigned int (unsigned int));
-            
-            inline void init(std::vector<unsigned int> const &elements)
+            for (SizeType bucket = 0; bucket < sizeOfSet; ++bucket)
             {
-                chooseHashFunction(elements, *this, [] (unsigned int x) -> unsigned int 
-                                                    {
-                                                        return x * x;
-                                                    }
-                );
-                
-                presence.assign(sizeOfSet, false);
-                if (elements.size() && std::count(elements.begin(), elements.end(), 0U) == 0U)
+                if (offsets[bucket] == offsets[bucket + 1U])
                 {
-                    hashElement[hash(0U)] = 1U;
+                    continue;
                 }
-            }
-            
-            inline void checkPossibility(unsigned int element) const
-            {
-                if (!isPossible(element))
+                if (!rebuilt[bucket])
                 {
-                    throw ImpossibleElementException(element);
+                    numberOfElements += innerHashSets[bucket].place(partition.begin() + offsets[bucket], partition.begin() + offsets[bucket + 1U]);
+                    continue;
+                }
+                std::vector<KeyType> bucketKeys;
+                std::vector<KeyType> presentKeys;
+                auto collect = [&bucketKeys, &presentKeys](KeyType key, bool present)
+                               {
+                                   bucketKeys.push_back(key);
+                                   if (present)
+                                   {
+                                       presentKeys.push_back(key);
+                                   }
+                               };
+                innerHashSets[bucket].forEachPossible(collect);
+                numberOfElements -= presentKeys.size();
+                for (SizeType i = offsets[bucket]; i < offsets[bucket + 1U]; ++i)
+                {
+                    collect(partition[i].first, partition[i].second);
+                }
+                innerHashSets[bucket].init(bucketKeys, policy.maxInnerLevelTrials, statistics);
+                for (auto const &key: presentKeys)
+                {
+                    numberOfElements += innerHashSets[bucket].insert(key);
                 }
             }
-            
-            inline bool operate(unsigned int element, bool operationType) // 1 - insert, 0 - remove;
+            return true;
+        }
+    
+    public:
+        BasicPerfectHashSet() : sizeOfSet(0U), numberOfElements(0U), numberOfSpeculativeTrials(1U),
+                                lowMemoryConstruction(false), lazyConstruction(false), duplicatePolicy(DETECT_WHILE_HASHING), engine(FKS_ENGINE), denseThreshold(32.0),
+                                scanThreshold(BasicScanSet<KeyType, SizeType>::MAX_KEYS), fingerprintBits(0U)
+        {
+        }
+        
+        BasicPerfectHashSet(BasicPerfectHashSet const &other) : BasicPerfectHashSet()
+        {
+            *this = other;
+        }
+        
+        BasicPerfectHashSet(BasicPerfectHashSet &&) = default;
+        
+        /* Pending buckets of a lazy other are built first, so the copy has none. */
+        BasicPerfectHashSet &operator=(BasicPerfectHashSet const &other)
+        {
+            if (this == &other)
             {
-                checkPossibility(element);
-                bool result = operationType ^ presence[hash(element)];
-                presence[hash(element)] = operationType;
-                return result;
+                return *this;
             }
+            other.buildPendingInnerHashSets();
+            innerHashSets = other.innerHashSets;
+            fingerprintTable = other.fingerprintTable;
+            innerSetsElements = other.innerSetsElements;
+            innerSetsOffsets = other.innerSetsOffsets;
+            partitionedElements = other.partitionedElements;
+            lazyState.reset();
+            hash = other.hash;
+            sizeOfSet = other.sizeOfSet;
+            numberOfElements = other.numberOfElements;
+            numberOfSpeculativeTrials = other.numberOfSpeculativeTrials;
+            lowMemoryConstruction = other.lowMemoryConstruction;
+            lazyConstruction = other.lazyConstruction;
+            duplicatePolicy = other.duplicatePolicy;
+            policy = other.policy;
+            statistics = other.statistics;
+            directSet = other.directSet;
+            scanSet = other.scanSet;
+            engine = other.engine;
+            denseThreshold = other.denseThreshold;
+            scanThreshold = other.scanThreshold;
+            fingerprintBits = other.fingerprintBits;
+            return *this;
+        }
+        
+        BasicPerfectHashSet &operator=(BasicPerfectHashSet &&) = default;
+        
+        /* init() keeps a bits-wide fingerprint per slot instead of the key, with the inner tables of all
+           buckets in flat arrays: isPossible() then also accepts an impossible key with probability about
+           2^-bits, and find(), insert() and erase() must only be given possible keys. bits is clamped to
+           [4, 16]; 0 keeps the keys. Lazy construction is ignored, every bucket is built by init(). The
+           scan and direct addressing engines stay exact, and such a set cannot be saved. */
+        inline void setFingerprintBits(unsigned int bits)
+        {
+            fingerprintBits = (bits ? std::min(std::max(bits, 4U), 16U) : 0U);
+        }
+        
+        /* init() of at most threshold elements, duplicates included, switches to a linear scan; at most
+           BasicScanSet::MAX_KEYS, the default, and 0 never scans. Checked before setDenseThreshold(). */
+        inline void setScanThreshold(unsigned int threshold)
+        {
+            scanThreshold = std::min(threshold, +BasicScanSet<KeyType, SizeType>::MAX_KEYS);
+        }
+        
+        /* init() switches to direct addressing when (max - min) / n of the elements is below threshold;
+           the bitmaps then take at most 2 * threshold bits per key. 32 by default; 0 always builds the
+           FKS tables. */
+        inline void setDenseThreshold(double threshold)
+        {
+            denseThreshold = std::max(threshold, 0.0);
+        }
+        
+        inline EEngine getEngine() const
+        {
+            return engine;
+        }
+        
+        /* init() only chooses the top-level hash and partitions the elements; every inner set is built
+           by the first operation touching its bucket, at most once even under concurrent readers.
+           Unless the duplicate policy checks up front, equal elements are then reported by that operation. */
+        inline void setLazyConstruction(bool enabled)
+        {
+            lazyConstruction = enabled;
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy policy)
+        {
+            duplicatePolicy = policy;
+        }
+        
+        /* Count bucket sizes instead of copying buckets while choosing the top-level hash and
+           build inner tables from one flat partition of the elements. */
+        inline void setLowMemoryConstruction(bool enabled)
+        {
+            lowMemoryConstruction = enabled;
+        }
+        
+        /* Number of top-level hash functions evaluated per pass over the elements in init(). */
+        inline void setNumberOfSpeculativeTrials(unsigned int trials)
+        {
+            numberOfSpeculativeTrials = std::max(trials, 1U);
+        }
+        
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Trials and fallbacks spent by the last init(). */
+        inline ConstructionStatistics const &getConstructionStatistics() const
+        {
+            return statistics;
+        }
+        
+        inline void build(std::vector<KeyType> const &elements)
+        {
+            chooseTopLevelHashFunction(elements);
             
-            bool insert(unsigned int element)
+            if (lazyConstruction)
             {
-                return operate(element, 1);
+                partitionElements(elements);
+                prepareLazyInnerHashSets();
             }
-            
-            bool erase(unsigned int element)
+            else if (lowMemoryConstruction)
             {
-                return operate(element, 0);
+                partitionElements(elements);
+                fillInnerHashSetsFromPartition();
             }
-            
-            bool find(unsigned int element) const
-            {           
-                checkPossibility(element);
-                return presence[hash(element)];
+            else
+            {
+                fillInnerHashSets();
             }
+        }
+        
+        inline void init(std::vector<KeyType> const &elements)
+        {   
+            numberOfElements = 0U;
+            statistics.clear();
+            lazyState.reset();
+            fingerprintTable = FingerprintTable();
             
-            bool isPossible(unsigned int element) const
+            if (!elements.empty() && elements.size() <= scanThreshold)
             {
-                return (presence.size() && hashElement[hash(element)] == element);
+                std::vector<InnerHashSet>().swap(innerHashSets);
+                directSet = BasicDirectSet<KeyType, SizeType>();
+                engine = SCAN_ENGINE;
+                scanSet.setDuplicatePolicy(duplicatePolicy);
+                scanSet.init(elements);
+                return;
             }
-        };
-        
-        
-        std::vector<InnerHashSet> innerHashSets;
-        std::vector<std::vector<unsigned int> > innerSetsElements;
-        Hash hash;
-        unsigned int sizeOfSet;
-        unsigned int numberOfElements;
-        
-        inline void checkEqualityAndThrowExceptionIfEqual(unsigned int firstElement, unsigned int secondElement) const
-        {
-            if (firstElement == secondElement)
+            if (isDense(elements))
             {
-                throw EqualElementsException(firstElement);
+                std::vector<InnerHashSet>().swap(innerHashSets);
+                engine = DIRECT_ENGINE;
+                directSet.setDuplicatePolicy(duplicatePolicy);
+                directSet.init(elements);
+                return;
+            }
+            engine = FKS_ENGINE;
+            directSet = BasicDirectSet<KeyType, SizeType>();
+            
+            std::vector<KeyType> uniqueElements;
+            bool hasDuplicates = (duplicatePolicy != DETECT_WHILE_HASHING && findDuplicates(elements, duplicatePolicy == THROW_ON_DUPLICATES, uniqueElements));
+            build(hasDuplicates ? uniqueElements : elements);
+            if (fingerprintBits)
+            {
+                packFingerprints();
             }
         }
         
-        inline bool isBadHashFunction(std::vector<unsigned int> const &elements)
+        /* Adds the possible keys of other, present ones staying present, and merges keys possible in both.
+           The top-level hash of the larger FKS table is kept with every inner set no new key falls into,
+           and an inner set whose new keys land on free slots only gets them written; other inner sets
+           are rebuilt from their keys. When the buckets would grow too large, or neither set uses the
+           FKS tables, the union goes through init(). Throws StorageException with fingerprints. */
+        void merge(BasicPerfectHashSet const &other)
         {
-            innerSetsElements.assign(sizeOfSet, std::vector<unsigned int> ());
-            
-            for (auto const &element: elements)
+            statistics.clear();
+            std::vector<std::pair<KeyType, bool> > keys;
+            auto collect = [&keys](KeyType key, bool present)
+                           {
+                               keys.push_back(std::make_pair(key, present));
+                           };
+            buildPendingInnerHashSets();
+            other.buildPendingInnerHashSets();
+            if (engine == FINGERPRINT_ENGINE || other.engine == FINGERPRINT_ENGINE)
             {
-                innerSetsElements[hash(element)].push_back(element);
+                throw StorageException("fingerprints cannot be merged as keys");
+            }
+            if (other.hasBuckets() && (!hasBuckets() || other.sizeOfSet > sizeOfSet))
+            {
+                forEachPossible(collect);
+                engine = FKS_ENGINE;
+                directSet = BasicDirectSet<KeyType, SizeType>();
+                scanSet = BasicScanSet<KeyType, SizeType>();
+                hash = other.hash;
+                sizeOfSet = other.sizeOfSet;
+                numberOfElements = other.numberOfElements;
+                innerHashSets = other.innerHashSets;
+            }
+            else
+            {
+                other.forEachPossible(collect);
             }
+            lazyState.reset();
             
-            unsigned long long sumOfSquaresOfInnerSetSizes = 0;
+            if (hasBuckets())
+            {
+                std::vector<std::pair<KeyType, bool> > newKeys;
+                for (auto const &key: keys)
+                {
+                    InnerHashSet &innerHashSet = innerHashSets[hash(key.first)];
+                    if (!innerHashSet.isPossible(key.first))
+                    {
+                        newKeys.push_back(key);
+                    }
+                    else if (key.second)
+                    {
+                        numberOfElements += innerHashSet.insert(key.first);
+                    }
+                }
+                if (mergeIntoBuckets(newKeys))
+                {
+                    return;
+                }
+            }
             
-            for (auto const &setElements: innerSetsElements)
+            forEachPossible(collect);
+            std::sort(keys.begin(), keys.end());
+            std::vector<KeyType> allKeys;
+            allKeys.reserve(keys.size());
+            for (auto const &key: keys)
             {
-                for (unsigned int i = 1; i < setElements.size(); ++i)
+                if (allKeys.empty() || allKeys.back() != key.first)
                 {
-                    checkEqualityAndThrowExceptionIfEqual(setElements[i - 1], setElements[i]);
+                    allKeys.push_back(key.first);
                 }
-                if (setElements.size() == 3U)
+            }
+            init(allKeys);
+            for (auto const &key: keys)
+            {
+                if (key.second)
                 {
-                    checkEqualityAndThrowExceptionIfEqual(setElements.front(), setElements.back());
+                    insert(key.first);
                 }
-                sumOfSquaresOfInnerSetSizes += square(setElements.size());
             }
-            return (sumOfSquaresOfInnerSetSizes > 3LLU * sizeOfSet);
         }
         
+        /* Calls action(key, present) for every possible key; throws StorageException with fingerprints. */
+        template<class Action>
+        void forEachPossible(Action action) const
+        {
+            if (engine == SCAN_ENGINE)
+            {
+                scanSet.forEachPossible(action);
+                return;
+            }
+            if (engine == DIRECT_ENGINE)
+            {
+                directSet.forEachPossible(action);
+                return;
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                throw StorageException("fingerprints cannot be enumerated as keys");
+            }
+            buildPendingInnerHashSets();
+            for (auto const &innerHashSet: innerHashSets)
+            {
+                innerHashSet.forEachPossible(action);
+            }
+        }
         
-        inline void fillInnerHashSets()
+        /* Binary image: sizeOfSet, numberOfElements, top-level hash, then every inner set in bucket order.
+           BasicExternalPerfectHashBuilder writes the same layout. */
+        void save(std::ostream &out) const
+        {
+            if (engine == DIRECT_ENGINE)
+            {
+                saveAsFks(directSet, out);
+                return;
+            }
+            if (engine == SCAN_ENGINE)
+            {
+                saveAsFks(scanSet, out);
+                return;
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                throw StorageException("fingerprints cannot be saved as keys");
+            }
+            buildPendingInnerHashSets();
+            writeValue(out, sizeOfSet);
+            writeValue(out, numberOfElements);
+            hash.save(out);
+            for (auto const &innerHashSet: innerHashSets)
+            {
+                innerHashSet.save(out);
+            }
+        }
+        
+        void load(std::istream &in)
         {
+            engine = FKS_ENGINE;
+            directSet = BasicDirectSet<KeyType, SizeType>();
+            fingerprintTable = FingerprintTable();
+            lazyState.reset();
+            sizeOfSet = readValue<SizeType>(in);
+            numberOfElements = readValue<SizeType>(in);
+            hash.load(in);
             innerHashSets.clear();
             innerHashSets.reserve(sizeOfSet);
-            
-            for (auto const &elements: innerSetsElements)
+            for (SizeType i = 0; i < sizeOfSet; ++i)
             {
-                innerHashSets.push_back(InnerHashSet(elements));
+                innerHashSets.emplace_back(in);
             }
         }
         
-        friend void chooseHashFunction<PerfectHashSet>(std::vector<unsigned int> const &, PerfectHashSet &, unsigned int (unsigned int));
-
-    public:
-        inline void init(std::vector<unsigned int> const &elements)
-        {   
-            numberOfElements = 0U;
-            chooseHashFunction(elements, *this, [](unsigned int x) -> unsigned int
-                                                {
-                                                    return x;
-                                                }
-            );
-            
-            fillInnerHashSets();
+        /* Steady-state footprint in bytes. */
+        unsigned long long memoryUsage() const
+        {
+            unsigned long long bytes = sizeof(BasicPerfectHashSet) + (innerHashSets.capacity() - innerHashSets.size()) * sizeof(InnerHashSet)
+                + directSet.memoryUsage() - sizeof(directSet) + fingerprintTable.memoryUsage() - sizeof(fingerprintTable);
+            for (auto const &innerHashSet: innerHashSets)
+            {
+                bytes += innerHashSet.memoryUsage();
+            }
+            if (lazyState)
+            {
+                std::lock_guard<std::mutex> lock(lazyState->mutex);
+                bytes += sizeof(LazyConstructionState) + sizeOfSet * sizeof(std::atomic<bool>) + bytesOf(innerSetsOffsets) + bytesOf(partitionedElements);
+            }
+            return bytes;
         }
         
-        void insert(unsigned int element) 
+        void insert(KeyType element) 
         {
-            numberOfElements += innerHashSets[hash(element)].insert(element);
+            if (engine == SCAN_ENGINE)
+            {
+                scanSet.insert(element);
+                return;
+            }
+            if (engine == DIRECT_ENGINE)
+            {
+                directSet.insert(element);
+                return;
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                numberOfElements += fingerprintTable.operate(touch(element), element, 1);
+                return;
+            }
+            numberOfElements += innerHashSets[touch(element)].insert(element);
         }
         
-        void erase(unsigned int element)
+        void erase(KeyType element)
         {
-            numberOfElements -= innerHashSets[hash(element)].erase(element);
+            if (engine == SCAN_ENGINE)
+            {
+                scanSet.erase(element);
+                return;
+            }
+            if (engine == DIRECT_ENGINE)
+            {
+                directSet.erase(element);
+                return;
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                numberOfElements -= fingerprintTable.operate(touch(element), element, 0);
+                return;
+            }
+            numberOfElements -= innerHashSets[touch(element)].erase(element);
         }
         
-        bool find(unsigned int element) const
+        bool find(KeyType element) const
         {
-            return innerHashSets[hash(element)].find(element);
+            if (engine == SCAN_ENGINE)
+            {
+                return scanSet.find(element);
+            }
+            if (engine == DIRECT_ENGINE)
+            {
+                return directSet.find(element);
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                return fingerprintTable.find(touch(element), element);
+            }
+            return innerHashSets[touch(element)].find(element);
         }
         
-        bool isPossible(unsigned int element) const
+        bool isPossible(KeyType element) const
         {
-            return innerHashSets[hash(element)].isPossible(element);
+            if (engine == SCAN_ENGINE)
+            {
+                return scanSet.isPossible(element);
+            }
+            if (engine == DIRECT_ENGINE)
+            {
+                return directSet.isPossible(element);
+            }
+            if (engine == FINGERPRINT_ENGINE)
+            {
+                return sizeOfSet && fingerprintTable.isPossible(hash(element), element);
+            }
+            return sizeOfSet && innerHashSets[touch(element)].isPossible(element);
         }
         
-        unsigned int size() const
+        SizeType size() const
         {
-            return numberOfElements;
+            if (engine == SCAN_ENGINE)
+            {
+                return scanSet.size();
+            }
+            return (engine == DIRECT_ENGINE ? directSet.size() : numberOfElements);
         }
     };
+    
+    typedef BasicPerfectHashSet<unsigned int, unsigned int, Hash> PerfectHashSet;
+    typedef BasicPerfectHashSet<unsigned long long, unsigned long long, WideHash> LargePerfectHashSet;
+#ifdef __SIZEOF_INT128__
+    typedef BasicPerfectHashSet<HugeKey, unsigned long long, MultilinearHash<HugeKey> > HugePerfectHashSet;
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,241 @@
+#ifndef _PTHASH_PERFECT_HASH_TABLE
+#define _PTHASH_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Minimal perfect hash set modelled on PTHash (Pibiri, Trani): keys are split into skewed buckets,
+       60% of the keys into 30% of the buckets, and buckets, largest first, search a pilot that sends
+       all their keys to free positions of a table of n / loadFactor positions. A lookup is one key hash,
+       one pilot load, one multiply-and-xor to the position and one slot load; the 1% of keys past
+       position n take one more load through the remap. Pilots are stored in a CompactArray. */
+    template<class KeyType, class SizeType>
+    class BasicPtHashSet: public IBasicSet<KeyType, SizeType>
+    {
+        static const unsigned long long PILOT_LIMIT = 1LLU << 20LLU; // searched per bucket before reseeding
+        static const unsigned long long PILOT_MULTIPLIER = 0x9E3779B97F4A7C15LLU;
+        static const unsigned long long POSITION_MULTIPLIER = 0xD6E8FEB86659FD93LLU;
+        
+        double bucketFactor;
+        double loadFactor;
+        EDuplicatePolicy duplicatePolicy;
+        ConstructionPolicy policy;
+        unsigned long long seed;
+        unsigned long long numberOfBuckets;
+        unsigned long long numberOfDenseBuckets;
+        unsigned long long numberOfPositions;
+        unsigned int numberOfSeeds;
+        CompactArray pilots;
+        CompactArray remap;
+        KeySlots<KeyType, SizeType> slots;
+        
+        inline unsigned long long bucket(unsigned long long hash) const
+        {
+            static const unsigned long long DENSE_HASHES = 0x99999999LLU; // 60% of the low half, independent of the high bits fastRange reads
+            if ((hash & UINT_MAX) < DENSE_HASHES)
+            {
+                return fastRange(hash, numberOfDenseBuckets);
+            }
+            return numberOfDenseBuckets + fastRange(hash, numberOfBuckets - numberOfDenseBuckets);
+        }
+        
+        /* The multiplication carries the low bits of the hash, which the bucket did not use, to the
+           high bits fastRange reads. */
+        inline unsigned long long position(unsigned long long hash, unsigned long long pilot) const
+        {
+            return fastRange((hash ^ (pilot * PILOT_MULTIPLIER)) * POSITION_MULTIPLIER, numberOfPositions);
+        }
+        
+        inline SizeType slot(KeyType element) const
+        {
+            if (!numberOfPositions)
+            {
+                return 0U;
+            }
+            unsigned long long hash = mixHash(element, seed);
+            unsigned long long candidate = position(hash, pilots[bucket(hash)]);
+            return (candidate < slots.numberOfSlots() ? candidate : remap[candidate - slots.numberOfSlots()]);
+        }
+        
+        /* Returns false when some bucket exhausts its pilots; the caller reseeds. */
+        bool tryBuild(std::vector<KeyType> const &elements)
+        {
+            unsigned long long numberOfSlots = elements.size();
+            std::vector<unsigned long long> hashes(numberOfSlots);
+            std::vector<unsigned long long> bucketOffsets(numberOfBuckets + 1U, 0LLU);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                hashes[i] = mixHash(elements[i], seed);
+                ++bucketOffsets[bucket(hashes[i]) + 1U];
+            }
+            
+            unsigned long long largestBucket = *std::max_element(bucketOffsets.begin(), bucketOffsets.end());
+            std::vector<std::vector<unsigned long long> > bucketsOfSize(largestBucket + 1U);
+            for (unsigned long long i = 0; i < numberOfBuckets; ++i)
+            {
+                bucketsOfSize[bucketOffsets[i + 1U]].push_back(i);
+                bucketOffsets[i + 1U] += bucketOffsets[i];
+            }
+            std::vector<unsigned long long> bucketHashes(numberOfSlots);
+            std::vector<unsigned long long> next(bucketOffsets.begin(), bucketOffsets.end() - 1);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                bucketHashes[next[bucket(hashes[i])]++] = hashes[i];
+            }
+            
+            std::vector<bool> taken(numberOfPositions, false);
+            std::vector<unsigned long long> values(numberOfBuckets, 0LLU);
+            std::vector<unsigned long long> bucketPositions;
+            for (unsigned long long size = largestBucket; size > 0U; --size)
+            {
+                for (auto const &currentBucket: bucketsOfSize[size])
+                {
+                    unsigned long long pilot = 0LLU;
+                    for (; pilot < PILOT_LIMIT; ++pilot)
+                    {
+                        bucketPositions.clear();
+                        for (unsigned long long i = bucketOffsets[currentBucket]; i < bucketOffsets[currentBucket + 1U]; ++i)
+                        {
+                            unsigned long long candidate = position(bucketHashes[i], pilot);
+                            if (taken[candidate])
+                            {
+                                break;
+                            }
+                            taken[candidate] = true;
+                            bucketPositions.push_back(candidate);
+                        }
+                        if (bucketPositions.size() == size)
+                        {
+                            break;
+                        }
+                        for (auto const &candidate: bucketPositions)
+                        {
+                            taken[candidate] = false;
+                        }
+                    }
+                    if (pilot == PILOT_LIMIT)
+                    {
+                        return false;
+                    }
+                    values[currentBucket] = pilot;
+                }
+            }
+            
+            pilots.assign(values);
+            assignRemap(taken, numberOfSlots, remap);
+            slots.assign(numberOfSlots);
+            for (unsigned long long i = 0; i < numberOfSlots; ++i)
+            {
+                slots.place(slot(elements[i]), elements[i]);
+            }
+            return true;
+        }
+    
+    public:
+        BasicPtHashSet() : bucketFactor(6.0), loadFactor(0.99), duplicatePolicy(DETECT_WHILE_HASHING), seed(0LLU), numberOfBuckets(1LLU),
+            numberOfDenseBuckets(1LLU), numberOfPositions(0LLU), numberOfSeeds(0U)
+        {
+        }
+        
+        /* c of c * n / log2(n) buckets; smaller is more compact but slower to build. */
+        inline void setBucketFactor(double newBucketFactor)
+        {
+            bucketFactor = std::max(newBucketFactor, 1.0);
+        }
+        
+        /* n / m; 1 needs no remap but makes the search for the last buckets long. */
+        inline void setLoadFactor(double newLoadFactor)
+        {
+            loadFactor = std::min(std::max(newLoadFactor, 0.5), 1.0);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        /* maxTopLevelTrials seeds per table size; when they all fail the positions double. */
+        inline void setConstructionPolicy(ConstructionPolicy const &newPolicy)
+        {
+            policy = newPolicy;
+        }
+        
+        /* Seeds tried by the last init(). */
+        inline unsigned int getNumberOfSeeds() const
+        {
+            return numberOfSeeds;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            double numberOfKeys = keys.size();
+            numberOfBuckets = std::max(2LLU, static_cast<unsigned long long>(std::ceil(bucketFactor * numberOfKeys / std::log2(std::max(numberOfKeys, 2.0)))));
+            numberOfDenseBuckets = std::max(1LLU, static_cast<unsigned long long>(0.3 * numberOfBuckets));
+            numberOfPositions = std::max<unsigned long long>(keys.size(), std::ceil(numberOfKeys / loadFactor));
+            unsigned long long minimalNumberOfPositions = numberOfPositions;
+            unsigned int tableFactor = 1U;
+            unsigned int numberOfTrials = 0U;
+            numberOfSeeds = 0U;
+            do
+            {
+                if (policy.maxTopLevelTrials && numberOfTrials == policy.maxTopLevelTrials)
+                {
+                    escalateConstruction(tableFactor);
+                    numberOfPositions = minimalNumberOfPositions * tableFactor;
+                    numberOfTrials = 0U;
+                }
+                seed = newSeed();
+                ++numberOfSeeds;
+                ++numberOfTrials;
+            }
+            while (!tryBuild(keys));
+        }
+        
+        /* Bits of hash function per key, excluding the key and presence arrays. */
+        double hashBitsPerKey() const
+        {
+            return (pilots.memoryUsage() + remap.memoryUsage() + sizeof(BasicPtHashSet)) * CHAR_BIT / std::max(1.0, 1.0 * slots.numberOfSlots());
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicPtHashSet) + pilots.memoryUsage() + remap.memoryUsage() + slots.memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            slots.insert(slot(element), element);
+        }
+        
+        void erase(KeyType element)
+        {
+            slots.erase(slot(element), element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return slots.find(slot(element), element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slots.isPossible(slot(element), element);
+        }
+        
+        SizeType size() const
+        {
+            return slots.size();
+        }
+    };
+    
+    typedef BasicPtHashSet<unsigned int, unsigned int> PtHashSet;
+    typedef BasicPtHashSet<unsigned long long, unsigned long long> LargePtHashSet;
+};
+
+#endif
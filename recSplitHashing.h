@@ -0,0 +1,331 @@
+#ifndef _RECSPLIT_PERFECT_HASH_TABLE
+#define _RECSPLIT_PERFECT_HASH_TABLE
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "compactHashing.h"
+
+namespace NPerfectHash
+{
+    /* Minimal perfect hash set by recursive splitting, as in RecSplit (Esposito, Muller Graf, Vigna).
+       Keys go to buckets of about bucketSize keys. A bucket is split by a seeded hash into parts of
+       fixed sizes, recursively, until the parts are leaves of at most leafSize keys, for which a seed
+       that is a bijection onto the leaf is searched. Only the seeds are stored, Golomb-Rice coded with
+       a parameter fitted to the success probability of each node size: 1.7 bits per key of seeds for
+       leafSize 8, against the 1.44 lower bound. Fixed and unary parts of the codes are kept in
+       separate streams, so a lookup skips a subtree by a known number of fixed bits and of ones. */
+    template<class KeyType, class SizeType>
+    class BasicRecSplitSet: public IBasicSet<KeyType, SizeType>
+    {
+        unsigned int leafSize;
+        unsigned int bucketSize;
+        EDuplicatePolicy duplicatePolicy;
+        unsigned long long seed;
+        unsigned long long numberOfBuckets;
+        unsigned long long lowerAggregation;
+        unsigned long long upperAggregation;
+        
+        // Per node size m: Rice width of the seed, and fixed bits and encoded nodes of the whole subtree.
+        std::vector<unsigned char> riceWidths;
+        std::vector<unsigned int> subtreeFixedBits;
+        std::vector<unsigned int> subtreeNodes;
+        
+        std::vector<unsigned long long> fixedWords;
+        std::vector<unsigned long long> unaryWords;
+        unsigned long long fixedLength;
+        unsigned long long unaryLength;
+        MonotoneArray keyOffsets;   // per bucket, then the total
+        MonotoneArray fixedOffsets;
+        MonotoneArray unaryOffsets;
+        KeySlots<KeyType, SizeType> slots;
+        
+        /* Splits of m keys: leaves below leafSize, then leaves aggregated into lowerAggregation,
+           those into upperAggregation, and halves of multiples of upperAggregation above. */
+        inline unsigned long long unitOf(unsigned long long m) const
+        {
+            if (m <= leafSize)
+            {
+                return m;
+            }
+            if (m <= lowerAggregation)
+            {
+                return leafSize;
+            }
+            if (m <= upperAggregation)
+            {
+                return lowerAggregation;
+            }
+            return (m / 2U + upperAggregation - 1U) / upperAggregation * upperAggregation;
+        }
+        
+        /* Rice width of a geometric number of failures with success probability e^logProbability. */
+        static unsigned int riceWidth(double logProbability)
+        {
+            double probability = std::exp(logProbability);
+            if (probability >= 1.0)
+            {
+                return 0U;
+            }
+            double golombParameter = -std::log(2.0 - probability) / std::log1p(-probability);
+            return (golombParameter >= 2.0 ? static_cast<unsigned int>(std::floor(std::log2(golombParameter))) : 0U);
+        }
+        
+        void computeTables(unsigned long long largestBucket)
+        {
+            std::vector<unsigned char>(largestBucket + 1U, 0U).swap(riceWidths);
+            std::vector<unsigned int>(largestBucket + 1U, 0U).swap(subtreeFixedBits);
+            std::vector<unsigned int>(largestBucket + 1U, 0U).swap(subtreeNodes);
+            for (unsigned long long m = 2; m <= largestBucket; ++m)
+            {
+                unsigned long long unit = unitOf(m);
+                double logProbability = std::lgamma(m + 1.0);
+                if (m <= leafSize)
+                {
+                    logProbability -= m * std::log(1.0 * m);
+                }
+                subtreeNodes[m] = 1U;
+                for (unsigned long long begin = 0; m > leafSize && begin < m; begin += unit)
+                {
+                    unsigned long long part = std::min(unit, m - begin);
+                    logProbability += part * std::log(1.0 * part / m) - std::lgamma(part + 1.0);
+                    subtreeFixedBits[m] += subtreeFixedBits[part];
+                    subtreeNodes[m] += subtreeNodes[part];
+                }
+                riceWidths[m] = riceWidth(logProbability);
+                subtreeFixedBits[m] += riceWidths[m];
+            }
+        }
+        
+        void appendCode(unsigned long long value, unsigned int width)
+        {
+            fixedWords.resize((fixedLength + width) / 64LLU + 1LLU, 0LLU);
+            writeBits(fixedWords, fixedLength, width, value & ((1LLU << width) - 1LLU));
+            fixedLength += width;
+            unaryLength += value >> width;
+            unaryWords.resize(unaryLength / 64LLU + 1LLU, 0LLU);
+            unaryWords[unaryLength >> 6LLU] |= 1LLU << (unaryLength & 63LLU);
+            ++unaryLength;
+        }
+        
+        inline unsigned long long readCode(unsigned long long &fixedPosition, unsigned long long &unaryPosition, unsigned int width) const
+        {
+            unsigned long long low = readBits(fixedWords, fixedPosition, width);
+            fixedPosition += width;
+            unsigned long long end = skipOnes(unaryWords, unaryPosition, 1LLU);
+            unsigned long long high = end - 1LLU - unaryPosition;
+            unaryPosition = end;
+            return (high << width) | low;
+        }
+        
+        /* Writes the seeds of the subtree of hashes[0, m) in preorder and leaves hashes grouped by part. */
+        void buildNode(unsigned long long *hashes, unsigned long long m, std::vector<unsigned long long> &scratch)
+        {
+            if (m <= 1U)
+            {
+                return;
+            }
+            unsigned long long x = 0LLU;
+            if (m <= leafSize)
+            {
+                for (;; ++x)
+                {
+                    unsigned long long used = 0LLU, i = 0LLU;
+                    for (; i < m; ++i)
+                    {
+                        unsigned long long bit = 1LLU << fastRange(mixHash(hashes[i], x), m);
+                        if (used & bit)
+                        {
+                            break;
+                        }
+                        used |= bit;
+                    }
+                    if (i == m)
+                    {
+                        break;
+                    }
+                }
+                appendCode(x, riceWidths[m]);
+                return;
+            }
+            
+            unsigned long long unit = unitOf(m);
+            unsigned long long fanout = (m + unit - 1U) / unit;
+            std::vector<unsigned long long> counts(fanout);
+            for (;; ++x)
+            {
+                std::fill(counts.begin(), counts.end(), 0LLU);
+                for (unsigned long long i = 0; i < m; ++i)
+                {
+                    ++counts[fastRange(mixHash(hashes[i], x), m) / unit];
+                }
+                unsigned long long part = 0LLU;
+                for (; part + 1U < fanout && counts[part] == unit; ++part);
+                if (part + 1U == fanout)
+                {
+                    break;
+                }
+            }
+            appendCode(x, riceWidths[m]);
+            
+            for (unsigned long long part = 0; part < fanout; ++part)
+            {
+                counts[part] = part * unit;
+            }
+            for (unsigned long long i = 0; i < m; ++i)
+            {
+                scratch[counts[fastRange(mixHash(hashes[i], x), m) / unit]++] = hashes[i];
+            }
+            std::copy(scratch.begin(), scratch.begin() + m, hashes);
+            for (unsigned long long begin = 0; begin < m; begin += unit)
+            {
+                buildNode(hashes + begin, std::min(unit, m - begin), scratch);
+            }
+        }
+        
+        inline SizeType slot(KeyType element) const
+        {
+            unsigned long long hash = mixHash(element, seed);
+            unsigned long long bucket = fastRange(hash, numberOfBuckets);
+            unsigned long long offset = keyOffsets[bucket];
+            unsigned long long m = keyOffsets[bucket + 1U] - offset;
+            unsigned long long fixedPosition = fixedOffsets[bucket];
+            unsigned long long unaryPosition = unaryOffsets[bucket];
+            while (m > 1U)
+            {
+                unsigned long long position = fastRange(mixHash(hash, readCode(fixedPosition, unaryPosition, riceWidths[m])), m);
+                if (m <= leafSize)
+                {
+                    return offset + position;
+                }
+                unsigned long long unit = unitOf(m);
+                unsigned long long part = position / unit;
+                fixedPosition += part * subtreeFixedBits[unit];
+                unaryPosition = skipOnes(unaryWords, unaryPosition, part * subtreeNodes[unit]);
+                offset += part * unit;
+                m = std::min(unit, m - part * unit);
+            }
+            return offset;
+        }
+    
+    public:
+        BasicRecSplitSet() : leafSize(8U), bucketSize(100U), duplicatePolicy(DETECT_WHILE_HASHING), seed(0LLU), numberOfBuckets(1LLU),
+            lowerAggregation(0LLU), upperAggregation(0LLU), fixedLength(0LLU), unaryLength(0LLU)
+        {
+        }
+        
+        /* Keys per leaf, at most 16; the bijection search takes about e^leafSize / sqrt(2 pi leafSize) trials. */
+        inline void setLeafSize(unsigned int newLeafSize)
+        {
+            leafSize = std::min(std::max(newLeafSize, 1U), 16U);
+        }
+        
+        /* Average keys per bucket; larger buckets spread the per-bucket offsets over more keys. */
+        inline void setBucketSize(unsigned int newBucketSize)
+        {
+            bucketSize = std::max(newBucketSize, 1U);
+        }
+        
+        inline void setDuplicatePolicy(EDuplicatePolicy newDuplicatePolicy)
+        {
+            duplicatePolicy = newDuplicatePolicy;
+        }
+        
+        void init(std::vector<KeyType> const &elements)
+        {
+            std::vector<KeyType> uniqueElements;
+            std::vector<KeyType> const &keys = distinctElements(elements, duplicatePolicy, uniqueElements);
+            lowerAggregation = leafSize * std::max(2U, static_cast<unsigned int>(std::ceil(0.35 * leafSize + 0.5)));
+            upperAggregation = lowerAggregation * (leafSize < 7U ? 2U : static_cast<unsigned int>(std::ceil(0.21 * leafSize + 0.9)));
+            numberOfBuckets = std::max(1LLU, (keys.size() + bucketSize - 1LLU) / bucketSize);
+            seed = newSeed();
+            
+            std::vector<unsigned long long> bucketBegins(numberOfBuckets + 1U, 0LLU);
+            for (auto const &key: keys)
+            {
+                ++bucketBegins[fastRange(mixHash(key, seed), numberOfBuckets) + 1U];
+            }
+            computeTables(*std::max_element(bucketBegins.begin(), bucketBegins.end()));
+            for (unsigned long long bucket = 0; bucket < numberOfBuckets; ++bucket)
+            {
+                bucketBegins[bucket + 1U] += bucketBegins[bucket];
+            }
+            std::vector<unsigned long long> hashes(keys.size());
+            std::vector<unsigned long long> next(bucketBegins.begin(), bucketBegins.end() - 1);
+            for (auto const &key: keys)
+            {
+                unsigned long long hash = mixHash(key, seed);
+                hashes[next[fastRange(hash, numberOfBuckets)]++] = hash;
+            }
+            
+            fixedWords.clear();
+            unaryWords.clear();
+            fixedLength = unaryLength = 0LLU;
+            std::vector<unsigned long long> fixedBegins(numberOfBuckets + 1U), unaryBegins(numberOfBuckets + 1U);
+            std::vector<unsigned long long> scratch(riceWidths.size());
+            for (unsigned long long bucket = 0; bucket < numberOfBuckets; ++bucket)
+            {
+                fixedBegins[bucket] = fixedLength;
+                unaryBegins[bucket] = unaryLength;
+                buildNode(hashes.data() + bucketBegins[bucket], bucketBegins[bucket + 1U] - bucketBegins[bucket], scratch);
+            }
+            fixedBegins.back() = fixedLength;
+            unaryBegins.back() = unaryLength;
+            std::vector<unsigned long long>(fixedWords.begin(), fixedWords.end()).swap(fixedWords);
+            std::vector<unsigned long long>(unaryWords.begin(), unaryWords.end()).swap(unaryWords);
+            keyOffsets.assign(bucketBegins);
+            fixedOffsets.assign(fixedBegins);
+            unaryOffsets.assign(unaryBegins);
+            
+            slots.assign(keys.size());
+            for (auto const &key: keys)
+            {
+                slots.place(slot(key), key);
+            }
+        }
+        
+        /* Bits of hash function per key, excluding the key and presence arrays. */
+        double hashBitsPerKey() const
+        {
+            unsigned long long bytes = sizeof(BasicRecSplitSet) + (fixedWords.capacity() + unaryWords.capacity()) * sizeof(unsigned long long)
+                + keyOffsets.memoryUsage() + fixedOffsets.memoryUsage() + unaryOffsets.memoryUsage()
+                + (subtreeFixedBits.capacity() + subtreeNodes.capacity()) * sizeof(unsigned int) + riceWidths.capacity();
+            return bytes * CHAR_BIT / std::max(1.0, 1.0 * slots.numberOfSlots());
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return static_cast<unsigned long long>(hashBitsPerKey() * std::max(1.0, 1.0 * slots.numberOfSlots()) / CHAR_BIT) + slots.memoryUsage();
+        }
+        
+        void insert(KeyType element)
+        {
+            slots.insert(slot(element), element);
+        }
+        
+        void erase(KeyType element)
+        {
+            slots.erase(slot(element), element);
+        }
+        
+        bool find(KeyType element) const
+        {
+            return slots.find(slot(element), element);
+        }
+        
+        bool isPossible(KeyType element) const
+        {
+            return slots.isPossible(slot(element), element);
+        }
+        
+        SizeType size() const
+        {
+            return slots.size();
+        }
+    };
+    
+    typedef BasicRecSplitSet<unsigned int, unsigned int> RecSplitSet;
+    typedef BasicRecSplitSet<unsigned long long, unsigned long long> LargeRecSplitSet;
+};
+
+#endif
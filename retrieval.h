@@ -0,0 +1,144 @@
+#ifndef _STATIC_RETRIEVAL
+#define _STATIC_RETRIEVAL
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "compactHashing.h"
+#include "fuseFilter.h"
+
+namespace NPerfectHash
+{
+    /* Static function from the keys given to init() to valueBits-bit values, without the keys: the
+       value of a key is the xor of the valueBits-bit words at its three FuseGraph positions, so it
+       takes about 1.13 * valueBits bits per key for large key sets and get() reads three words. Keys
+       not given to init() get an arbitrary value; use a set or a BasicFuseFilter to tell them apart. */
+    template<class KeyType>
+    class BasicRetrieval
+    {
+        FuseGraph graph;
+        unsigned int valueBits;
+        std::vector<unsigned long long> words;
+        unsigned long long numberOfKeys;
+        
+        inline unsigned long long valueAt(unsigned long long position) const
+        {
+            return readBits(words, position * valueBits, valueBits);
+        }
+        
+        inline unsigned long long valueMask() const
+        {
+            return (valueBits == 64U ? ULLONG_MAX : (1LLU << valueBits) - 1LLU);
+        }
+        
+        /* Indices of the distinct keys; equal keys must have equal values. */
+        static std::vector<unsigned long long> distinctKeys(std::vector<KeyType> const &keys, std::vector<unsigned long long> const &values, unsigned long long mask)
+        {
+            std::vector<unsigned long long> indices(keys.size());
+            for (unsigned long long i = 0; i < indices.size(); ++i)
+            {
+                indices[i] = i;
+            }
+            std::sort(indices.begin(), indices.end(), [&keys](unsigned long long first, unsigned long long second)
+            {
+                return keys[first] < keys[second];
+            });
+            unsigned long long distinct = 0LLU;
+            for (unsigned long long i = 0; i < indices.size(); ++i)
+            {
+                if (distinct && keys[indices[distinct - 1U]] == keys[indices[i]])
+                {
+                    if (((values[indices[distinct - 1U]] ^ values[indices[i]]) & mask) != 0LLU)
+                    {
+                        throw EqualElementsException(keys[indices[i]]);
+                    }
+                    continue;
+                }
+                indices[distinct++] = indices[i];
+            }
+            indices.resize(distinct);
+            return indices;
+        }
+    
+    public:
+        BasicRetrieval() : valueBits(8U), numberOfKeys(0LLU)
+        {
+        }
+        
+        /* Applies from the next init(); clamped to [1, 64]. */
+        inline void setValueBits(unsigned int newValueBits)
+        {
+            valueBits = std::min(std::max(newValueBits, 1U), 64U);
+        }
+        
+        inline unsigned int getValueBits() const
+        {
+            return valueBits;
+        }
+        
+        /* Maps keys[i] to the low valueBits bits of values[i]. Equal keys are merged when their
+           values are equal too; otherwise EqualElementsException is thrown. Throws
+           std::invalid_argument, changing nothing, unless there is one value per key. */
+        void init(std::vector<KeyType> const &keys, std::vector<unsigned long long> const &values)
+        {
+            if (values.size() != keys.size())
+            {
+                throw std::invalid_argument("one value per key is needed");
+            }
+            std::vector<unsigned long long> indices = distinctKeys(keys, values, valueMask());
+            std::vector<KeyType> distinct(indices.size());
+            for (unsigned long long i = 0; i < indices.size(); ++i)
+            {
+                distinct[i] = keys[indices[i]];
+            }
+            numberOfKeys = distinct.size();
+            std::vector<unsigned long long>((graph.setSizes(distinct.size()) * valueBits + 63LLU) / 64LLU, 0LLU).swap(words);
+            std::vector<std::pair<unsigned long long, unsigned char> > order;
+            graph.peel(distinct, order);
+            
+            unsigned long long keyPositions[FuseGraph::ARITY + 2U];
+            for (unsigned long long i = order.size(); i-- > 0;)
+            {
+                graph.positions(graph.hash(distinct[order[i].first]), keyPositions);
+                unsigned int found = order[i].second;
+                unsigned long long value = (values[indices[order[i].first]] ^ valueAt(keyPositions[found + 1U]) ^ valueAt(keyPositions[found + 2U])) & valueMask();
+                writeBits(words, keyPositions[found] * valueBits, valueBits, value);
+            }
+        }
+        
+        /* Value of a key given to init(); arbitrary for other keys. */
+        unsigned long long get(KeyType element) const
+        {
+            if (graph.empty())
+            {
+                return 0LLU;
+            }
+            unsigned long long keyPositions[FuseGraph::ARITY + 2U];
+            graph.positions(graph.hash(element), keyPositions);
+            return valueAt(keyPositions[0]) ^ valueAt(keyPositions[1]) ^ valueAt(keyPositions[2]);
+        }
+        
+        /* Distinct keys of the last init(). */
+        inline unsigned long long size() const
+        {
+            return numberOfKeys;
+        }
+        
+        unsigned long long memoryUsage() const
+        {
+            return sizeof(BasicRetrieval) + words.capacity() * sizeof(unsigned long long);
+        }
+        
+        /* Bits per key beyond the valueBits every value needs: the unused positions of the graph. */
+        double overheadBitsPerKey() const
+        {
+            return memoryUsage() * static_cast<double>(CHAR_BIT) / std::max(1LLU, numberOfKeys) - valueBits;
+        }
+    };
+    
+    typedef BasicRetrieval<unsigned int> Retrieval;
+    typedef BasicRetrieval<unsigned long long> LargeRetrieval;
+};
+
+#endif
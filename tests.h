@@ -6,8 +6,26 @@
 #include <vector>
 #include <algorithm>
 #include <climits>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
 #include "testlib.h"
 #include "perfectHashing.h"
+#include "externalPerfectHashing.h"
+#include "incrementalPerfectHashing.h"
+#include "backgroundPerfectHashing.h"
+#include "chdHashing.h"
+#include "ptHashing.h"
+#include "bbHashing.h"
+#include "recSplitHashing.h"
+#include "monotoneHashing.h"
+#include "dynamicPerfectHashing.h"
+#include "cuckooHashing.h"
+#include "autoHashing.h"
+#include "fuseFilter.h"
+#include "retrieval.h"
+#include "perfectHashMap.h"
 
 namespace NPerfectHashTests
 {
@@ -47,11 +65,20 @@ namespace NPerfectHashTests
         
         std::vector <unsigned int> possibleElements;
         std::set<unsigned int> currentQuery;
+        bool removeDuplicates;
     public:
+        explicit WorkingSet(bool removeDuplicates = false) : removeDuplicates(removeDuplicates)
+        {
+        }
+        
         void init(std::vector<unsigned int> const &elements)
         {
             possibleElements = elements;
             std::sort(possibleElements.begin(), possibleElements.end());
+            if (removeDuplicates)
+            {
+                possibleElements.erase(std::unique(possibleElements.begin(), possibleElements.end()), possibleElements.end());
+            }
             for (unsigned int i = 1; i < possibleElements.size(); ++i)
             {
                 if (possibleElements[i] == possibleElements[i - 1])
@@ -99,6 +126,628 @@ namespace NPerfectHashTests
         }
     };
 
+    /* PerfectHashSet whose init() goes through ExternalPerfectHashBuilder and load(). */
+    class ExternalConstructionSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::PerfectHashSet set;
+        NPerfectHash::ExternalPerfectHashBuilder builder;
+    public:
+        ExternalConstructionSet(std::string const &workingDirectory, unsigned int numberOfPartitions) :
+            builder(workingDirectory, numberOfPartitions)
+        {
+        }
+        
+        /* The image is built in memory; only the builder's own temporary files touch the disk. */
+        void init(std::vector<unsigned int> const &elements)
+        {
+            std::stringstream keys, image;
+            NPerfectHash::writeValues(keys, elements.data(), elements.size());
+            builder.build(keys, image);
+            set.load(image);
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(element);
+        }
+        
+        unsigned int size() const
+        {
+            return set.size();
+        }
+    };
+
+    /* Runs init() of the given PerfectHashSet through BasicIncrementalBuilder in steps of workPerStep
+       units, so the set's construction and duplicate policies apply. */
+    class IncrementalConstructionSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::PerfectHashSet &set;
+        unsigned long long workPerStep;
+    public:
+        IncrementalConstructionSet(NPerfectHash::PerfectHashSet &set, unsigned long long workPerStep) : set(set), workPerStep(std::max(workPerStep, 1LLU))
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            NPerfectHash::IncrementalPerfectHashBuilder builder(set, elements);
+            while (!builder.step(workPerStep));
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(element);
+        }
+        
+        unsigned int size() const
+        {
+            return set.size();
+        }
+    };
+    
+    /* PerfectHashSet built as two key-range shards merged into one: the upper shard takes about
+       eighths / 8 of the elements. Every key is inserted into its shard before the merge, then checked
+       to be present in the union and erased; size() reports UINT_MAX if the count was wrong. */
+    class MergedSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::PerfectHashSet &set;
+        NPerfectHash::PerfectHashSet shard;
+        unsigned int eighths;
+        bool consistent;
+    public:
+        MergedSet(NPerfectHash::PerfectHashSet &set, NPerfectHash::EDuplicatePolicy duplicatePolicy, unsigned int eighths) : set(set), eighths(std::min(eighths, 8U)), consistent(true)
+        {
+            shard.setDuplicatePolicy(duplicatePolicy);
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            std::vector<unsigned int> sorted(elements);
+            std::sort(sorted.begin(), sorted.end());
+            unsigned int pivot = (eighths && !sorted.empty() ? sorted[sorted.size() - (sorted.size() * eighths + 7U) / 8U] : UINT_MAX);
+            std::vector<unsigned int> lower, upper;
+            for (auto const &element: elements)
+            {
+                (element < pivot || !eighths ? lower : upper).push_back(element);
+            }
+            set.init(lower);
+            shard.init(upper);
+            for (auto const &element: lower)
+            {
+                set.insert(element);
+            }
+            for (auto const &element: upper)
+            {
+                shard.insert(element);
+            }
+            set.merge(shard);
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            consistent = (set.size() == sorted.size());
+            for (auto const &element: sorted)
+            {
+                set.erase(element);
+            }
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(element);
+        }
+        
+        unsigned int size() const
+        {
+            return (consistent ? set.size() : UINT_MAX);
+        }
+    };
+    
+    /* Answers the queries of MonotoneSet through its order queries: find() and isPossible() count
+       present and possible keys in [element, element + 1), size() walks the present keys in order
+       and counts the present keys below each, so a wrong rank, range count or iteration shows as a
+       different answer. */
+    class OrderedQueriesSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::MonotoneSet &set;
+    public:
+        explicit OrderedQueriesSet(NPerfectHash::MonotoneSet &set) : set(set)
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            set.init(elements);
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            unsigned int rank = set.rank(element);
+            if (element == UINT_MAX)
+            {
+                return set.size() - set.presentBelow(element);
+            }
+            return (set.possibleBelow(element) == rank && set.countPresent(element, element + 1U) == 1U);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            if (element == UINT_MAX)
+            {
+                return set.isPossible(element);
+            }
+            return set.possibleBelow(element + 1U) - set.possibleBelow(element) == 1U;
+        }
+        
+        unsigned int size() const
+        {
+            unsigned int count = 0U;
+            bool ordered = true;
+            unsigned int previous = 0U;
+            set.forEachPresent([&](unsigned int element)
+                               {
+                                   ordered = ordered && (!count || previous < element) && set.presentBelow(element) == count;
+                                   previous = element;
+                                   ++count;
+                               }
+            );
+            return (ordered ? count : UINT_MAX);
+        }
+    };
+    
+    /* Set with addPossible() and removePossible(), such as DynamicPerfectHashSet or CuckooSet, whose
+       init() is followed by churn of the possible keys: all of them are removed, added back and
+       inserted, half of them removed and added again, and all erased. Keys inserted before a rebuild
+       must still be found after it, otherwise size() reports UINT_MAX. */
+    template<class DynamicSetType>
+    class DynamicUniverseSet: public NPerfectHash::ISet
+    {
+        DynamicSetType &set;
+        bool consistent;
+    public:
+        explicit DynamicUniverseSet(DynamicSetType &set) : set(set), consistent(true)
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            set.init(elements);
+            for (auto const &element: elements)
+            {
+                if (set.isPossible(element))
+                {
+                    set.removePossible(element);
+                }
+            }
+            for (auto const &element: elements)
+            {
+                set.addPossible(element);
+                set.insert(element);
+            }
+            for (unsigned int i = 1; i < elements.size(); i += 2U)
+            {
+                if (set.isPossible(elements[i]))
+                {
+                    set.removePossible(elements[i]);
+                }
+            }
+            for (unsigned int i = 1; i < elements.size(); i += 2U)
+            {
+                set.addPossible(elements[i]);
+            }
+            consistent = true;
+            for (unsigned int i = 0; i < elements.size(); i += 2U)
+            {
+                consistent = consistent && set.find(elements[i]);
+            }
+            for (auto const &element: elements)
+            {
+                set.erase(element);
+            }
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(element);
+        }
+        
+        unsigned int size() const
+        {
+            return (consistent ? set.size() : UINT_MAX);
+        }
+    };
+    
+    /* PerfectHashSet in fingerprint mode checked against the exact keys: impossible keys are answered
+       from the exact keys, as the harness expects, while the fingerprint answers are checked. size()
+       reports UINT_MAX once a possible key was rejected, or once the distinct impossible keys accepted
+       since init() exceed four times the expected 2^-bits of the distinct impossible keys queried plus
+       a slack of 8. A key is counted once however often it is queried: its answer never changes. */
+    class FingerprintSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::PerfectHashSet &set;
+        unsigned int fingerprintBits;
+        std::set<unsigned int> keys;
+        mutable std::set<unsigned int> impossibleKeys;
+        mutable std::set<unsigned int> falsePositives;
+        mutable bool consistent;
+        
+        inline void checkPossibility(unsigned int element) const
+        {
+            if (!isPossible(element))
+            {
+                throw NPerfectHash::ImpossibleElementException(element);
+            }
+        }
+    public:
+        FingerprintSet(NPerfectHash::PerfectHashSet &set, unsigned int fingerprintBits) : set(set), fingerprintBits(fingerprintBits), consistent(true)
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            set.init(elements);
+            keys = std::set<unsigned int>(elements.begin(), elements.end());
+            impossibleKeys.clear();
+            falsePositives.clear();
+            consistent = true;
+        }
+        
+        void insert(unsigned int element)
+        {
+            checkPossibility(element);
+            set.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            checkPossibility(element);
+            set.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            checkPossibility(element);
+            return set.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            bool possible = keys.count(element);
+            bool answer = set.isPossible(element);
+            consistent = consistent && (answer || !possible);
+            if (!possible)
+            {
+                impossibleKeys.insert(element);
+                if (answer)
+                {
+                    falsePositives.insert(element);
+                }
+            }
+            return possible;
+        }
+        
+        unsigned int size() const
+        {
+            bool rare = (falsePositives.size() <= 4.0 * impossibleKeys.size() / (1LLU << fingerprintBits) + 8.0);
+            return (consistent && rare ? set.size() : UINT_MAX);
+        }
+    };
+    
+    /* Retrieval checked against the exact keys: init() maps every key to a hash of itself, the set
+       answers come from a WorkingSet, and every query on a possible key checks its retrieved value.
+       init() also checks that one value too few is rejected without touching the mapping. size()
+       reports UINT_MAX once a value was wrong or the short values were accepted. */
+    class RetrievalSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::Retrieval &retrieval;
+        WorkingSet keys;
+        mutable bool consistent;
+        
+        inline unsigned long long valueOf(unsigned int element) const
+        {
+            unsigned long long value = NPerfectHash::mixHash(element, 0LLU);
+            return (retrieval.getValueBits() == 64U ? value : value & ((1LLU << retrieval.getValueBits()) - 1LLU));
+        }
+        
+        inline void check(unsigned int element) const
+        {
+            if (keys.isPossible(element))
+            {
+                consistent = consistent && (retrieval.get(element) == valueOf(element));
+            }
+        }
+    public:
+        RetrievalSet(NPerfectHash::Retrieval &retrieval, bool removeDuplicates) : retrieval(retrieval), keys(removeDuplicates), consistent(true)
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            keys.init(elements);
+            std::vector<unsigned long long> values(elements.size());
+            for (unsigned int i = 0; i < elements.size(); ++i)
+            {
+                values[i] = valueOf(elements[i]);
+            }
+            retrieval.init(elements, values);
+            consistent = true;
+            if (!elements.empty())
+            {
+                values.pop_back();
+                try
+                {
+                    retrieval.init(elements, values);
+                    consistent = false;
+                }
+                catch (std::invalid_argument const &)
+                {
+                }
+            }
+        }
+        
+        void insert(unsigned int element)
+        {
+            check(element);
+            keys.insert(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            check(element);
+            keys.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            check(element);
+            return keys.find(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            check(element);
+            return keys.isPossible(element);
+        }
+        
+        unsigned int size() const
+        {
+            return (consistent ? keys.size() : UINT_MAX);
+        }
+    };
+    
+    /* PerfectHashMap whose present keys are set to a hash of themselves: every operation on a
+       possible key reads it back with get() and checks presence and value, and size() reports
+       UINT_MAX once one was wrong. */
+    class MapSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::PerfectHashMap<unsigned long long> &map;
+        mutable bool consistent;
+        
+        static inline unsigned long long valueOf(unsigned int element)
+        {
+            return NPerfectHash::mixHash(element, 1LLU);
+        }
+        
+        inline bool check(unsigned int element) const
+        {
+            unsigned long long value = 0LLU;
+            bool present = map.get(element, value);
+            consistent = consistent && present == map.find(element) && (!present || value == valueOf(element));
+            return present;
+        }
+    public:
+        explicit MapSet(NPerfectHash::PerfectHashMap<unsigned long long> &map) : map(map), consistent(true)
+        {
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            map.init(elements);
+            consistent = true;
+        }
+        
+        void insert(unsigned int element)
+        {
+            map.set(element, valueOf(element));
+            check(element);
+        }
+        
+        void erase(unsigned int element)
+        {
+            check(element);
+            map.erase(element);
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return check(element);
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            if (map.isPossible(element))
+            {
+                check(element);
+                return true;
+            }
+            return false;
+        }
+        
+        unsigned int size() const
+        {
+            return (consistent ? map.size() : UINT_MAX);
+        }
+    };
+    
+    /* Runs the 32-bit test cases against LargePerfectHashSet: every key is spread injectively
+       over the whole 64-bit universe, so the high half of the keys is always involved. */
+    class LargeKeysSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::LargePerfectHashSet set;
+        
+        static unsigned long long widen(unsigned int element)
+        {
+            return NPerfectHash::compositeKey(element, element ^ 0x9E3779B9U);
+        }
+    public:
+        // small test cases would otherwise be answered by a linear scan instead of the FKS tables
+        LargeKeysSet()
+        {
+            set.setScanThreshold(0U);
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            std::vector<unsigned long long> wideElements(elements.size());
+            std::transform(elements.begin(), elements.end(), wideElements.begin(), widen);
+            set.init(wideElements);
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(widen(element));
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(widen(element));
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(widen(element));
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(widen(element));
+        }
+        
+        unsigned int size() const
+        {
+            return set.size();
+        }
+    };
+    
+#ifdef __SIZEOF_INT128__
+    /* Runs the 32-bit test cases against HugePerfectHashSet: every key is spread injectively over
+       all four 32-bit words of a 128-bit key. */
+    class HugeKeysSet: public NPerfectHash::ISet
+    {
+        NPerfectHash::HugePerfectHashSet set;
+        
+        static NPerfectHash::HugeKey widen(unsigned int element)
+        {
+            return NPerfectHash::compositeKey(NPerfectHash::compositeKey(element, element ^ 0x9E3779B9U), NPerfectHash::compositeKey(~element, element * 0x85EBCA6BU));
+        }
+    public:
+        // small test cases would otherwise be answered by a linear scan instead of the FKS tables
+        HugeKeysSet()
+        {
+            set.setScanThreshold(0U);
+        }
+        
+        void init(std::vector<unsigned int> const &elements)
+        {
+            std::vector<NPerfectHash::HugeKey> wideElements(elements.size());
+            std::transform(elements.begin(), elements.end(), wideElements.begin(), widen);
+            set.init(wideElements);
+        }
+        
+        void insert(unsigned int element)
+        {
+            set.insert(widen(element));
+        }
+        
+        void erase(unsigned int element)
+        {
+            set.erase(widen(element));
+        }
+        
+        bool find(unsigned int element) const
+        {
+            return set.find(widen(element));
+        }
+        
+        bool isPossible(unsigned int element) const
+        {
+            return set.isPossible(widen(element));
+        }
+        
+        unsigned int size() const
+        {
+            return set.size();
+        }
+    };
+#endif
+    
     class ITest
     {
     public:
@@ -119,7 +768,7 @@ namespace NPerfectHashTests
         
         void init()
         {
-            avalibleElements.assign(rnd.next(maxNumberOfElements / 2, maxNumberOfElements), rnd.next(UINT_MAX));
+            avalibleElements.assign(rnd.next(maxNumberOfElements / 2, maxNumberOfElements), rnd.next(0U, UINT_MAX - 1U));
         }
         
     public:
@@ -216,10 +865,10 @@ namespace NPerfectHashTests
         void init()
         {
             unsigned int firstElement, secondElement;
-            firstElement = rnd.next(UINT_MAX);
+            firstElement = rnd.next(0U, UINT_MAX - 1U);
             do
             {
-                secondElement = rnd.next(UINT_MAX);
+                secondElement = rnd.next(0U, UINT_MAX - 1U);
             }
             while (firstElement == secondElement);
             unsigned int n = rnd.next(maxNumberOfElements / 4, maxNumberOfElements / 2);
@@ -277,10 +926,10 @@ namespace NPerfectHashTests
         void init()
         {
             unsigned int firstElement, secondElement;
-            firstElement = rnd.next(UINT_MAX);
+            firstElement = rnd.next(0U, UINT_MAX - 1U);
             do
             {
-                secondElement = rnd.next(UINT_MAX);
+                secondElement = rnd.next(0U, UINT_MAX - 1U);
             }
             while (firstElement == secondElement);
             unsigned int n = rnd.next(maxNumberOfElements / 4, maxNumberOfElements / 2);
@@ -312,10 +961,10 @@ namespace NPerfectHashTests
         
         TwoElementInitTestEveryOrder(unsigned int numberOfElements) : numberOfElements(numberOfElements)
         {
-            firstElement = rnd.next(UINT_MAX);
+            firstElement = rnd.next(0U, UINT_MAX - 1U);
             do
             {
-                secondElement = rnd.next(UINT_MAX);
+                secondElement = rnd.next(0U, UINT_MAX - 1U);
             }
             while (firstElement == secondElement);
             avalibleElements.resize(2 * numberOfElements);
@@ -448,7 +1097,7 @@ namespace NPerfectHashTests
             {
                 do
                 {
-                    element = rnd.next(UINT_MAX);
+                    element = rnd.next(0U, UINT_MAX - 1U);
                 }
                 while (used.find(element) != used.end());
                 avalibleElements[2U * i] = avalibleElements[2U * i + 1] = element;
@@ -473,7 +1122,7 @@ namespace NPerfectHashTests
             {
                 do
                 {
-                    element = rnd.next(UINT_MAX);
+                    element = rnd.next(0U, UINT_MAX - 1U);
                 }
                 while (used.find(element) != used.end());
                 avalibleElements[2U * i] = avalibleElements[2U * i + 1] = element;
@@ -720,6 +1369,93 @@ namespace NPerfectHashTests
         }
     }
     
+    /* Footprint of a minimal perfect hashing engine after its last init(). */
+    template<class EngineType>
+    void printMemoryUsage(EngineType const &engine)
+    {
+        printf("Memory usage bytes:      %llu\n", engine.memoryUsage());
+        printf("Hash bits per key:       %.3lf\n", engine.hashBitsPerKey());
+    }
+    
+    bool throwsSizeOverflow(unsigned long long factor, unsigned long long numberOfElements, unsigned long long multiplier)
+    {
+        try
+        {
+            NPerfectHash::tableSize<unsigned int>(factor, numberOfElements, multiplier);
+        }
+        catch (NPerfectHash::SizeOverflowException &)
+        {
+            return true;
+        }
+        return false;
+    }
+    
+    unsigned long long sumOfSquares(unsigned long long sum, unsigned long long x)
+    {
+        NPerfectHash::addSquare(sum, x);
+        return sum;
+    }
+    
+    /* tableSize() and addSquare() at the 2^32 boundary of unsigned int: every table past it has to
+       throw SizeOverflowException and every sum of squares has to saturate. With largeCount, also
+       builds a PerfectHashSet of that many distinct keys, which takes about 16 bytes per key; the
+       build either answers every key or reports SizeOverflowException, it never wraps. */
+    void testSizeLimits(unsigned int largeCount)
+    {
+        bool const checks[] =
+        {
+            NPerfectHash::tableSize<unsigned int>(1LLU, UINT_MAX, 1LLU) == UINT_MAX,
+            throwsSizeOverflow(1LLU, 1LLU << 32, 1LLU),
+            throwsSizeOverflow(2LLU, 1LLU << 31, 1LLU),
+            throwsSizeOverflow(1LLU, 1LLU << 16, 1LLU << 16),
+            NPerfectHash::tableSize<unsigned int>(1LLU, 65535LLU, 65535LLU) == 65535U * 65535U,
+            NPerfectHash::tableSize<unsigned long long>(2LLU, 1LLU << 31, 1LLU << 31) == 1LLU << 63,
+            sumOfSquares(0LLU, UINT_MAX) == 1LLU * UINT_MAX * UINT_MAX,
+            sumOfSquares(0LLU, 1LLU << 32) == ULLONG_MAX,
+            sumOfSquares(ULLONG_MAX - 5LLU, 2LLU) == ULLONG_MAX - 1LLU,
+            sumOfSquares(ULLONG_MAX - 3LLU, 2LLU) == ULLONG_MAX,
+            sumOfSquares(ULLONG_MAX, 0LLU) == ULLONG_MAX
+        };
+        for (unsigned int i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i)
+        {
+            if (!checks[i])
+            {
+                printf("\nDifferent size limit - check %u\n", i + 1U);
+            }
+        }
+        if (largeCount)
+        {
+            // an odd multiplier is a bijection of unsigned int, which spreads the keys over the whole range
+            std::vector<unsigned int> elements(largeCount);
+            for (unsigned int i = 0; i < largeCount; ++i)
+            {
+                elements[i] = i * 2654435761U;
+            }
+            NPerfectHash::PerfectHashSet set;
+            set.setDenseThreshold(0.0);
+            set.setScanThreshold(0U);
+            try
+            {
+                set.init(elements);
+                unsigned int found = 0;
+                for (auto const &element: elements)
+                {
+                    set.insert(element);
+                    found += set.find(element);
+                }
+                if (found != largeCount || set.size() != largeCount || set.isPossible(largeCount * 2654435761U))
+                {
+                    printf("\nDifferent Answers - %u keys\n", largeCount);
+                }
+            }
+            catch (NPerfectHash::SizeOverflowException &exception)
+            {
+                printf("%s", exception.what());
+            }
+        }
+        printf("\n");
+    }
+    
     void test(ITest &testCase, NPerfectHash::ISet *firstSet, NPerfectHash::ISet *secondSet = NULL)
     {
         unsigned int testNumber = 0U;
@@ -753,7 +1489,7 @@ namespace NPerfectHashTests
                         printf("\nDifferent Exception result - test %u\n", testNumber);
                         break;
                     }
-                    if (firstSetResult != secondSetResult)
+                    if (!firstExceptionHandled && firstSetResult != secondSetResult)
                     {
                         printf("\nDifferent Answers - test %u\n", testNumber);
                         break;